@@ -0,0 +1,335 @@
+#include "kernel/charconv.hpp"
+#include "kernel/util.hpp"
+#include <cstring>
+
+namespace kernel::charconv_detail {
+
+const char LowerDigits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+const char UpperDigits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+namespace {
+
+constexpr char DigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+constexpr std::uint64_t Pow10[20] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL,
+};
+
+constexpr std::uint64_t Pow10_19 = Pow10[19];
+
+struct DigitTable {
+    unsigned char value[256];
+    constexpr DigitTable() : value{}
+    {
+        for (int i = 0; i < 256; ++i) {
+            value[i] = 0xFF;
+        }
+        for (int i = 0; i < 10; ++i) {
+            value['0' + i] = (unsigned char)i;
+        }
+        for (int i = 0; i < 26; ++i) {
+            value['a' + i] = (unsigned char)(10 + i);
+            value['A' + i] = (unsigned char)(10 + i);
+        }
+    }
+};
+
+constexpr DigitTable Digits;
+
+auto DigitValue(char ch) -> unsigned
+{
+    return Digits.value[(unsigned char)ch];
+}
+
+auto DecimalDigits(std::uint64_t value) -> int
+{
+    // log10(2) ~ 1233 / 4096
+    int t = ((Log2U64(value | 1) + 1) * 1233) >> 12;
+    int digits = t + (value >= Pow10[t]);
+    return digits ? digits : 1;
+}
+
+void WriteDecimal(char* end, std::uint64_t value)
+{
+    while (value >= 100) {
+        auto pair = unsigned(value % 100) * 2;
+        value /= 100;
+        *--end = DigitPairs[pair + 1];
+        *--end = DigitPairs[pair];
+    }
+    if (value >= 10) {
+        auto pair = unsigned(value) * 2;
+        *--end = DigitPairs[pair + 1];
+        *--end = DigitPairs[pair];
+    } else {
+        *--end = char('0' + value);
+    }
+}
+
+// Writes exactly 19 digits, zero padded, for the lower chunks of 128-bit values
+void WriteDecimal19(char* end, std::uint64_t value)
+{
+    for (int i = 0; i < 9; ++i) {
+        auto pair = unsigned(value % 100) * 2;
+        value /= 100;
+        *--end = DigitPairs[pair + 1];
+        *--end = DigitPairs[pair];
+    }
+    *--end = char('0' + value);
+}
+
+auto Load64(const char* ptr) -> std::uint64_t
+{
+    std::uint64_t v;
+    std::memcpy(&v, ptr, 8);
+    return v;
+}
+
+constexpr std::uint64_t Ones = 0x0101010101010101;
+constexpr std::uint64_t HighBits = 0x8080808080808080;
+
+bool IsEightDecimalDigits(std::uint64_t v)
+{
+    return !(((v + 0x4646464646464646) | (v - 0x3030303030303030)) & HighBits);
+}
+
+// SWAR conversion of eight ASCII decimal digits, first character most significant
+auto ParseEightDecimal(std::uint64_t v) -> std::uint32_t
+{
+    constexpr std::uint64_t Mask = 0x000000FF000000FF;
+    constexpr std::uint64_t Mul1 = 100 + (1000000ULL << 32);
+    constexpr std::uint64_t Mul2 = 1 + (10000ULL << 32);
+    v -= 0x3030303030303030;
+    v = (v * 10) + (v >> 8);
+    v = (((v & Mask) * Mul1) + (((v >> 16) & Mask) * Mul2)) >> 32;
+    return std::uint32_t(v);
+}
+
+// Per-byte high bit set where lo <= byte <= hi; bytes must be below 0x80
+constexpr auto InRange(std::uint64_t v, unsigned char lo, unsigned char hi) -> std::uint64_t
+{
+    auto ge = v + Ones * (0x80 - lo);
+    auto gt = v + Ones * (0x80 - hi - 1);
+    return ge & ~gt & HighBits;
+}
+
+// SWAR conversion of eight ASCII hex digits; returns false if any byte is not a hex digit
+bool ParseEightHex(std::uint64_t v, std::uint32_t& out)
+{
+    if (v & HighBits) {
+        return false;
+    }
+    auto lower = v | (Ones * 0x20);
+    auto digit = InRange(v, '0', '9');
+    auto alpha = InRange(lower, 'a', 'f');
+    if ((digit | alpha) != HighBits) {
+        return false;
+    }
+    auto nibbles = (lower & (Ones * 0x0F)) + (alpha >> 7) * 9;
+    auto pairs = ((nibbles & 0x000F000F000F000F) << 4) | ((nibbles >> 8) & 0x000F000F000F000F);
+    auto packed = (pairs & 0xFF) | ((pairs >> 8) & 0xFF00) |
+        ((pairs >> 16) & 0xFF0000) | ((pairs >> 24) & 0xFF000000);
+    out = __builtin_bswap32(std::uint32_t(packed));
+    return true;
+}
+
+template <typename U>
+auto ToCharsPow2(char* first, char* last, U value, int bits, const char* digits) -> ToCharsResult
+{
+    int valueBits;
+    if constexpr (sizeof(U) > 8) {
+        auto hi = std::uint64_t(value >> 64);
+        valueBits = hi ? 65 + Log2U64(hi) : 1 + Log2U64(std::uint64_t(value) | 1);
+    } else {
+        valueBits = 1 + Log2U64(value | 1);
+    }
+    auto count = (valueBits + bits - 1) / bits;
+    if (last - first < count) {
+        return { last, ConvStatus::ValueTooLarge };
+    }
+    auto mask = unsigned((1 << bits) - 1);
+    auto end = first + count;
+    for (auto p = end; p != first;) {
+        *--p = digits[unsigned(value) & mask];
+        value >>= bits;
+    }
+    return { end, ConvStatus::Ok };
+}
+
+template <typename U>
+auto ToCharsGeneric(char* first, char* last, U value, int base, const char* digits) -> ToCharsResult
+{
+    int count = 0;
+    for (U v = value; ; v /= unsigned(base)) {
+        ++count;
+        if (v < unsigned(base)) {
+            break;
+        }
+    }
+    if (last - first < count) {
+        return { last, ConvStatus::ValueTooLarge };
+    }
+    auto end = first + count;
+    for (auto p = end; p != first; value /= unsigned(base)) {
+        *--p = digits[unsigned(value % unsigned(base))];
+    }
+    return { end, ConvStatus::Ok };
+}
+
+bool IsPow2Base(int base, int& bits)
+{
+    if (base & (base - 1)) {
+        return false;
+    }
+    bits = ctz64(base);
+    return true;
+}
+
+template <typename U>
+auto FromCharsImpl(const char* first, const char* last, U& result, int base) -> FromCharsResult
+{
+    if (base < 2 || base > 36) {
+        return { first, ConvStatus::InvalidArgument };
+    }
+    U value = 0;
+    bool overflow = false;
+    auto p = first;
+    if (base == 10) {
+        while (last - p >= 8) {
+            auto chunk = Load64(p);
+            if (!IsEightDecimalDigits(chunk)) {
+                break;
+            }
+            if (__builtin_mul_overflow(value, U(100000000), &value) ||
+                __builtin_add_overflow(value, U(ParseEightDecimal(chunk)), &value)) {
+                overflow = true;
+            }
+            p += 8;
+        }
+    } else if (base == 16) {
+        std::uint32_t chunk;
+        while (last - p >= 8 && ParseEightHex(Load64(p), chunk)) {
+            if (value >> (sizeof(U) * 8 - 32)) {
+                overflow = true;
+            }
+            value = (value << 32) | chunk;
+            p += 8;
+        }
+    }
+    for (; p != last; ++p) {
+        auto digit = DigitValue(*p);
+        if (digit >= unsigned(base)) {
+            break;
+        }
+        if (__builtin_mul_overflow(value, U(base), &value) ||
+            __builtin_add_overflow(value, U(digit), &value)) {
+            overflow = true;
+        }
+    }
+    if (p == first) {
+        return { first, ConvStatus::InvalidArgument };
+    }
+    if (overflow) {
+        return { p, ConvStatus::ValueTooLarge };
+    }
+    result = value;
+    return { p, ConvStatus::Ok };
+}
+
+} // namespace
+
+auto ToChars(char* first, char* last, std::uint64_t value, int base,
+    const char* digits) -> ToCharsResult
+{
+    if (base < 2 || base > 36) {
+        return { first, ConvStatus::InvalidArgument };
+    }
+    if (base == 10) {
+        auto count = DecimalDigits(value);
+        if (last - first < count) {
+            return { last, ConvStatus::ValueTooLarge };
+        }
+        WriteDecimal(first + count, value);
+        return { first + count, ConvStatus::Ok };
+    }
+    int bits;
+    if (IsPow2Base(base, bits)) {
+        return ToCharsPow2(first, last, value, bits, digits);
+    }
+    return ToCharsGeneric(first, last, value, base, digits);
+}
+
+auto ToChars(char* first, char* last, uint128_t value, int base,
+    const char* digits) -> ToCharsResult
+{
+    if ((value >> 64) == 0 || base < 2 || base > 36) {
+        return ToChars(first, last, std::uint64_t(value), base, digits);
+    }
+    if (base == 10) {
+        auto low = std::uint64_t(value % Pow10_19);
+        value /= Pow10_19;
+        auto mid = std::uint64_t(value % Pow10_19);
+        auto high = std::uint64_t(value / Pow10_19);
+        auto count = high ? DecimalDigits(high) + 38 : DecimalDigits(mid) + 19;
+        if (last - first < count) {
+            return { last, ConvStatus::ValueTooLarge };
+        }
+        auto end = first + count;
+        WriteDecimal19(end, low);
+        if (high) {
+            WriteDecimal19(end - 19, mid);
+            WriteDecimal(end - 38, high);
+        } else {
+            WriteDecimal(end - 19, mid);
+        }
+        return { end, ConvStatus::Ok };
+    }
+    int bits;
+    if (IsPow2Base(base, bits)) {
+        return ToCharsPow2(first, last, value, bits, digits);
+    }
+    return ToCharsGeneric(first, last, value, base, digits);
+}
+
+auto FromChars(const char* first, const char* last, std::uint64_t& value,
+    int base) -> FromCharsResult
+{
+    return FromCharsImpl(first, last, value, base);
+}
+
+auto FromChars(const char* first, const char* last, uint128_t& value,
+    int base) -> FromCharsResult
+{
+    return FromCharsImpl(first, last, value, base);
+}
+
+} // namespace kernel::charconv_detail
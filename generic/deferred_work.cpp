@@ -0,0 +1,76 @@
+#include "kernel/deferred_work.hpp"
+
+namespace kernel {
+
+namespace {
+
+using ReadyList = intrusive::List<DeferredWork>;
+
+// Producers push onto the inbox stack, the consumer takes it whole and
+// moves it to the ready list in arrival order. Both are constant
+// initialised because interrupts use them before global constructors run
+constinit std::atomic<DeferredWork*> inbox;
+constinit ReadyList ready;
+// The idle thread runs work with interrupts enabled, an interrupt that
+// arrives meanwhile leaves it to that pass
+constinit std::atomic<bool> running;
+
+} // namespace
+
+bool DeferredWork::Schedule() noexcept
+{
+    if (requests.fetch_add(1, std::memory_order_relaxed) != 0) {
+        return false;
+    }
+    auto head = inbox.load(std::memory_order_relaxed);
+    do {
+        inboxNext = head;
+    } while (!inbox.compare_exchange_weak(head, this,
+        std::memory_order_release, std::memory_order_relaxed));
+    // A non-empty inbox already has a kick on its way or a pass to run it
+    if (head == nullptr) {
+        KickDeferredWork();
+    }
+    return true;
+}
+
+auto RunDeferredWork(unsigned budget) noexcept -> bool
+{
+    if (running.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+    auto takeInbox = [] {
+        auto head = inbox.exchange(nullptr, std::memory_order_acquire);
+        DeferredWork* reversed = nullptr;
+        while (head != nullptr) {
+            auto next = head->inboxNext;
+            head->inboxNext = reversed;
+            reversed = head;
+            head = next;
+        }
+        for (; reversed != nullptr; reversed = reversed->inboxNext) {
+            ready.PushBack(*reversed);
+        }
+    };
+    takeInbox();
+    while (budget != 0 && !ready.Empty()) {
+        auto& work = *ready.Begin();
+        ready.Erase(work);
+        // Clear before the call so a request made while running queues again
+        auto count = work.requests.exchange(0, std::memory_order_acquire);
+        work.fn(work.ctx, count);
+        --budget;
+        if (ready.Empty()) {
+            takeInbox();
+        }
+    }
+    running.store(false, std::memory_order_release);
+    return DeferredWorkPending();
+}
+
+bool DeferredWorkPending() noexcept
+{
+    return !ready.Empty() || inbox.load(std::memory_order_relaxed) != nullptr;
+}
+
+} // namespace kernel
@@ -0,0 +1,231 @@
+#include "kernel/executor.hpp"
+#include <cstdint>
+#include "kernel/interrupts.hpp"
+#include "kernel/log.hpp"
+#include "kernel/rcu.hpp"
+
+namespace kernel {
+
+namespace executor_detail {
+
+constexpr unsigned SpinRounds = 256;
+constexpr std::size_t SplitsPerCPU = 8;
+
+// Chase-Lev deque over a fixed ring, after Le et al. "Correct and
+// Efficient Work-Stealing for Weak Memory Models". The owning CPU pushes
+// and pops at the bottom, thieves take from the top.
+class Deque {
+public:
+    static constexpr std::int64_t Capacity = 128;
+
+    bool Push(Task* task) noexcept
+    {
+        auto b = bottom.load(std::memory_order_relaxed);
+        auto t = top.load(std::memory_order_acquire);
+        if (b - t >= Capacity) {
+            return false;
+        }
+        slots[b % Capacity].store(task, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    auto Pop() noexcept -> Task*
+    {
+        auto b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        auto task = slots[b % Capacity].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last entry, race thieves for it
+            if (!top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                task = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    auto Steal() noexcept -> Task*
+    {
+        auto t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        auto task = slots[t % Capacity].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return task;
+    }
+
+    bool Empty() const noexcept
+    {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+private:
+    std::atomic<std::int64_t> top;
+    std::atomic<std::int64_t> bottom;
+    std::atomic<Task*> slots[Capacity];
+};
+
+struct alignas(64) Worker {
+    Deque deque;
+    std::uint32_t seed = 0;
+};
+
+struct Executor {
+    Worker workers[MaxCPUs];
+    std::atomic<unsigned> sleepers;
+
+    static void Run(Task& task) noexcept
+    {
+        task.fn(task.ctx);
+        // The owner may free the task as soon as it sees done
+        task.done.store(true, std::memory_order_release);
+    }
+
+    auto NextVictim(Worker& self, unsigned count) noexcept -> unsigned
+    {
+        auto x = self.seed;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        self.seed = x;
+        return x % count;
+    }
+
+    // Own deque first, then one round over the other CPUs from a random
+    // starting point. Owner side operations are kept atomic against
+    // preemption, which could run another thread on this CPU's deque.
+    auto FindWork() noexcept -> Task*
+    {
+        unsigned index;
+        {
+            InterruptGuard guard;
+            index = this_cpu().index;
+            auto& self = workers[index];
+            if (self.seed == 0) {
+                self.seed = index * 2654435761U + 1;
+            }
+            if (auto task = self.deque.Pop()) {
+                return task;
+            }
+        }
+        auto count = CPUCount();
+        auto start = NextVictim(workers[index], count);
+        for (unsigned i = 0; i < count; ++i) {
+            auto victim = (start + i) % count;
+            if (victim == index) {
+                continue;
+            }
+            if (auto task = workers[victim].deque.Steal()) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    bool AnyWork() noexcept
+    {
+        auto count = CPUCount();
+        for (unsigned i = 0; i < count; ++i) {
+            if (!workers[i].deque.Empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+namespace {
+
+constinit Executor executor;
+
+} // namespace
+
+auto DefaultGrain(std::size_t count) noexcept -> std::size_t
+{
+    auto grain = count / (CPUCount() * SplitsPerCPU);
+    return grain == 0 ? 1 : grain;
+}
+
+} // namespace executor_detail
+
+void spawn(Task& task) noexcept
+{
+    using executor_detail::executor;
+    if (CPUCount() > 1) {
+        bool queued;
+        {
+            InterruptGuard guard;
+            queued = executor.workers[this_cpu().index].deque.Push(&task);
+        }
+        if (queued) {
+            // Pairs with the fence in RunExecutor() so either the sleeper
+            // sees the task or the sleeper count is seen here
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (executor.sleepers.load(std::memory_order_relaxed) != 0) {
+                WakeIdleCPUs();
+            }
+            return;
+        }
+    }
+    executor_detail::Executor::Run(task);
+}
+
+void join(Task& task) noexcept
+{
+    using executor_detail::executor;
+    while (!task.Done()) {
+        if (auto other = executor.FindWork()) {
+            executor_detail::Executor::Run(*other);
+        } else {
+            CPURelax();
+        }
+    }
+}
+
+void RunExecutor() noexcept
+{
+    using executor_detail::executor;
+    unsigned idleRounds = 0;
+    while (true) {
+        if (auto task = executor.FindWork()) {
+            executor_detail::Executor::Run(*task);
+            RCUQuiescentState();
+            idleRounds = 0;
+            continue;
+        }
+        if (++idleRounds < executor_detail::SpinRounds) {
+            CPURelax();
+            continue;
+        }
+        idleRounds = 0;
+        RCUQuiescentState();
+        FlushLog();
+        SaveAndDisableInterrupts();
+        executor.sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (executor.AnyWork()) {
+            EnableInterrupts();
+        } else {
+            WaitForInterrupt();
+        }
+        executor.sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace kernel
@@ -0,0 +1,156 @@
+#include "kernel/format.hpp"
+#include "kernel/charconv.hpp"
+#include <cstring>
+
+namespace kernel::format_detail {
+
+namespace {
+
+constexpr std::size_t MaxDigits = 64;
+
+void WriteNumber(Writer& out, std::uint64_t value, bool negative, Spec spec,
+    Presentation def)
+{
+    char buf[MaxDigits];
+    const char* prefix = "";
+    auto type = spec.type == Presentation::Default ? def : spec.type;
+    int base = 10;
+    auto digitSet = charconv_detail::LowerDigits;
+    switch (type) {
+    case Presentation::HexLower:
+    case Presentation::Pointer:
+        base = 16;
+        prefix = "0x";
+        break;
+    case Presentation::HexUpper:
+        base = 16;
+        digitSet = charconv_detail::UpperDigits;
+        prefix = "0X";
+        break;
+    case Presentation::Octal:
+        base = 8;
+        prefix = "0";
+        break;
+    case Presentation::Binary:
+        base = 2;
+        prefix = "0b";
+        break;
+    default:
+        break;
+    }
+    auto begin = buf;
+    auto end = charconv_detail::ToChars(buf, buf + MaxDigits, value, base, digitSet).ptr;
+    if (!spec.alternate && type != Presentation::Pointer) {
+        prefix = "";
+    }
+    std::size_t digits = std::size_t(end - begin);
+    std::size_t prefixSize = std::strlen(prefix) + negative;
+    std::size_t pad = spec.width > digits + prefixSize ? spec.width - digits - prefixSize : 0;
+    if (!spec.zeroPad) {
+        out.Pad(' ', pad);
+    }
+    if (negative) {
+        out.Put('-');
+    }
+    out.Put(prefix, prefixSize - negative);
+    if (spec.zeroPad) {
+        out.Pad('0', pad);
+    }
+    out.Put(begin, digits);
+}
+
+void WriteString(Writer& out, std::string_view str, Spec spec)
+{
+    if (spec.width > str.size()) {
+        out.Pad(' ', spec.width - str.size());
+    }
+    out.Put(str.data(), str.size());
+}
+
+void WriteHexDump(Writer& out, const HexDump& dump, Spec spec)
+{
+    auto digits = spec.type == Presentation::HexUpper ?
+        charconv_detail::UpperDigits : charconv_detail::LowerDigits;
+    auto bytes = static_cast<const unsigned char*>(dump.data);
+    for (std::size_t i = 0; i < dump.size; ++i) {
+        if (i != 0) {
+            out.Put(' ');
+        }
+        out.Put(digits[bytes[i] >> 4]);
+        out.Put(digits[bytes[i] & 0xF]);
+    }
+}
+
+} // namespace
+
+void Writer::Put(const char* str, std::size_t size)
+{
+    auto avail = std::size_t(end - cur);
+    if (size > avail) {
+        size = avail;
+    }
+    std::memcpy(cur, str, size);
+    cur += size;
+}
+
+void WriteArg(Writer& out, const Arg& arg, Spec spec)
+{
+    switch (arg.kind) {
+    case ArgKind::Bool:
+        if (spec.type == Presentation::Default || spec.type == Presentation::String) {
+            WriteString(out, arg.u ? "true" : "false", spec);
+            return;
+        }
+        WriteNumber(out, arg.u, false, spec, Presentation::Decimal);
+        return;
+    case ArgKind::Char:
+        if (spec.type == Presentation::Default || spec.type == Presentation::Char) {
+            out.Pad(' ', spec.width > 1 ? spec.width - 1 : 0);
+            out.Put(char(arg.u));
+            return;
+        }
+        WriteNumber(out, arg.u, false, spec, Presentation::Decimal);
+        return;
+    case ArgKind::Signed:
+        if (spec.type == Presentation::Char) {
+            out.Put(char(arg.i));
+            return;
+        }
+        WriteNumber(out, arg.i < 0 ? 0 - std::uint64_t(arg.i) : std::uint64_t(arg.i),
+            arg.i < 0, spec, Presentation::Decimal);
+        return;
+    case ArgKind::Unsigned:
+        if (spec.type == Presentation::Char) {
+            out.Put(char(arg.u));
+            return;
+        }
+        WriteNumber(out, arg.u, false, spec, Presentation::Decimal);
+        return;
+    case ArgKind::Pointer:
+        WriteNumber(out, reinterpret_cast<std::uintptr_t>(arg.p), false, spec,
+            Presentation::Pointer);
+        return;
+    case ArgKind::String:
+        WriteString(out, arg.s, spec);
+        return;
+    case ArgKind::HexDump:
+        WriteHexDump(out, arg.h, spec);
+        return;
+    case ArgKind::None:
+        return;
+    }
+}
+
+void Format(Writer& out, const char* fmt, const Segment* segments,
+    std::size_t segCount, const Arg* args)
+{
+    for (std::size_t i = 0; i < segCount; ++i) {
+        auto& seg = segments[i];
+        out.Put(fmt + seg.literalOffset, seg.literalSize);
+        if (seg.arg >= 0) {
+            WriteArg(out, args[seg.arg], seg.spec);
+        }
+    }
+}
+
+} // namespace kernel::format_detail
@@ -0,0 +1,185 @@
+#include "kernel/heap_profile.hpp"
+
+#ifdef KERNEL_HEAP_PROFILE
+#include <algorithm>
+#include "kernel/debug.h"
+#include "kernel/format.hpp"
+#include "kernel/spinlock.hpp"
+#include "kernel/stacktrace.hpp"
+#include "kernel/util.hpp"
+
+namespace kernel {
+
+namespace heap_profile_detail {
+
+constexpr std::size_t SiteCount = 1024;
+constexpr std::size_t SampleCount = 256;
+constexpr std::size_t SampleDepth = 8;
+constexpr std::size_t TopSites = 20;
+
+struct Site {
+    std::uintptr_t address;
+    std::uint64_t allocs;
+    std::uint64_t frees;
+    std::uint64_t liveBytes;
+    std::uint64_t peakBytes;
+};
+
+struct Sample {
+    // nullptr once freed or never used
+    void* ptr;
+    std::size_t size;
+    std::size_t depth;
+    std::uintptr_t stack[SampleDepth];
+};
+
+// Sites live in an open-addressed table keyed by return address; once it
+// is full new sites are charged to a single overflow entry. Samples go to
+// a ring that overwrites the oldest one.
+struct Profile {
+    TicketLock lock{ "heap profile" };
+    Site sites[SiteCount] = {};
+    std::size_t usedSites = 0;
+    Site overflow = {};
+    Sample samples[SampleCount] = {};
+    std::size_t nextSample = 0;
+    std::uint64_t untilSample = HeapSampleBytes;
+    std::uint64_t random = 0x9E3779B97F4A7C15;
+
+    auto Find(std::uintptr_t address) noexcept -> Site&
+    {
+        auto index = std::size_t(address * 0x9E3779B97F4A7C15 >> 54) & (SiteCount - 1);
+        for (std::size_t probe = 0; probe < SiteCount; ++probe) {
+            auto& site = sites[(index + probe) & (SiteCount - 1)];
+            if (site.address == address) {
+                return site;
+            }
+            if (site.address == 0) {
+                if (usedSites * 4 >= SiteCount * 3) {
+                    break;
+                }
+                ++usedSites;
+                site.address = address;
+                return site;
+            }
+        }
+        return overflow;
+    }
+
+    // Exponentially distributed with mean HeapSampleBytes, -ln(u) computed
+    // as -log2(u) * ln(2) with log2 interpolated linearly between powers of
+    // two. The interpolation overestimates -log2(u) by about 4% on average,
+    // so ln(2) * 2^16 = 45426 is scaled down to keep the mean.
+    auto NextSampleDistance() noexcept -> std::uint64_t
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        auto u = (random >> 32) | 1;
+        auto msb = std::uint64_t(Log2U64(u));
+        auto log2u = (msb << 16) + (((u - (std::uint64_t(1) << msb)) << 16) >> msb);
+        auto negLog2 = (std::uint64_t(32) << 16) - log2u;
+        return (HeapSampleBytes * negLog2 * 43753 >> 32) + 1;
+    }
+
+    void Record(void* ptr, std::size_t size) noexcept
+    {
+        auto& sample = samples[nextSample];
+        nextSample = (nextSample + 1) % SampleCount;
+        sample.ptr = ptr;
+        sample.size = size;
+        sample.depth = CaptureStackTrace(sample.stack);
+    }
+};
+
+namespace {
+
+constinit Profile profile;
+
+} // namespace
+
+} // namespace heap_profile_detail
+
+bool HeapProfileAlloc(void* ptr, std::size_t size, std::uintptr_t site) noexcept
+{
+    using heap_profile_detail::profile;
+    SpinLockGuard guard(profile.lock);
+    auto& entry = profile.Find(site);
+    ++entry.allocs;
+    entry.liveBytes += size;
+    entry.peakBytes = std::max(entry.peakBytes, entry.liveBytes);
+    if (size < profile.untilSample) {
+        profile.untilSample -= size;
+        return false;
+    }
+    profile.untilSample = profile.NextSampleDistance();
+    profile.Record(ptr, size);
+    return true;
+}
+
+void HeapProfileFree(void* ptr, std::size_t size, std::uintptr_t site, bool sampled) noexcept
+{
+    using heap_profile_detail::profile;
+    SpinLockGuard guard(profile.lock);
+    auto& entry = profile.Find(site);
+    ++entry.frees;
+    entry.liveBytes -= std::min<std::uint64_t>(entry.liveBytes, size);
+    if (!sampled) {
+        return;
+    }
+    for (auto& sample : profile.samples) {
+        if (sample.ptr == ptr) {
+            sample.ptr = nullptr;
+            break;
+        }
+    }
+}
+
+void DumpHeapProfile() noexcept
+{
+    using namespace heap_profile_detail;
+    Site top[TopSites + 1] = {};
+    std::size_t count = 0;
+    {
+        SpinLockGuard guard(profile.lock);
+        // Insertion into a short sorted array, the table is mostly empty
+        auto consider = [&](const Site& site) {
+            if (site.allocs == 0) {
+                return;
+            }
+            auto i = count;
+            while (i != 0 && top[i - 1].liveBytes < site.liveBytes) {
+                top[i] = top[i - 1];
+                --i;
+            }
+            top[i] = site;
+            count = std::min(count + 1, TopSites);
+        };
+        for (auto& site : profile.sites) {
+            consider(site);
+        }
+        consider(profile.overflow);
+    }
+    char buf[160];
+    debug::println("[Heap] site allocs frees live/peak bytes");
+    for (std::size_t i = 0; i < count; ++i) {
+        auto& site = top[i];
+        debug::println({buf, format_to(buf, "[Heap] {:#x} {} {} {}/{}",
+            site.address, site.allocs, site.frees, site.liveBytes, site.peakBytes)});
+    }
+    debug::println({buf, format_to(buf, "[Heap] live samples, about one per {} bytes allocated", HeapSampleBytes)});
+    SpinLockGuard guard(profile.lock);
+    for (auto& sample : profile.samples) {
+        if (sample.ptr == nullptr) {
+            continue;
+        }
+        debug::puts({buf, format_to(buf, "[Heap] {:p} {}:", sample.ptr, sample.size)});
+        for (std::size_t i = 0; i < sample.depth; ++i) {
+            debug::puts({buf, format_to(buf, " {:#x}", sample.stack[i])});
+        }
+        debug::putc('\n');
+    }
+}
+
+} // namespace kernel
+#endif
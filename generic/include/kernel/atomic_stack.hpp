@@ -0,0 +1,94 @@
+#ifndef ATOMIC_STACK_H
+#define ATOMIC_STACK_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "node.hpp"
+#include "slist_node.hpp"
+
+namespace kernel::intrusive {
+
+template <typename T, typename CastPolicyGen = BaseClassCastPolicy<AtomicSListNode<>, T>>
+class AtomicStack;
+
+/**
+ * Lock-free Treiber stack for free lists shared between CPUs. The top
+ * pointer carries a modification count in its unused upper bits, so a pop
+ * that raced with a pop and push of the same node fails its CAS instead
+ * of linking a stale next pointer (ABA). A popper may still read the link
+ * of a node another CPU has just taken, so nodes must stay mapped while
+ * the stack is in use; any other reuse of their memory is fine.
+ */
+template <typename T, typename CastPolicyGen>
+class AtomicStack : detail::ContainerNodeRequirments<T, CastPolicyGen> {
+    using CastPolicy = CastPolicyGen;
+    using NodeType = typename CastPolicy::NodeType;
+
+    // Canonical 48-bit virtual addresses, the pointer is sign extended back
+    static constexpr unsigned PointerBits = 48;
+    static constexpr std::uint64_t PointerMask = (std::uint64_t(1) << PointerBits) - 1;
+    static constexpr std::uint64_t TagOne = std::uint64_t(1) << PointerBits;
+public:
+    constexpr AtomicStack() noexcept :
+        top(0)
+    {}
+
+    AtomicStack(const AtomicStack&) = delete;
+    AtomicStack& operator=(const AtomicStack&) = delete;
+
+    void Push(T& ref) noexcept
+    {
+        NodeType* elem = CastPolicy::ToNode(std::addressof(ref));
+        auto old = top.load(std::memory_order_relaxed);
+        std::uint64_t desired;
+        do {
+            elem->next.store(Unpack(old), std::memory_order_relaxed);
+            desired = Pack(elem, old);
+        } while (!top.compare_exchange_weak(old, desired,
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /**
+     * Unlinks and returns the top item, nullptr if the stack is empty.
+     */
+    auto Pop() noexcept -> T*
+    {
+        auto old = top.load(std::memory_order_acquire);
+        NodeType* elem;
+        std::uint64_t desired;
+        do {
+            elem = static_cast<NodeType*>(Unpack(old));
+            if (elem == nullptr) {
+                return nullptr;
+            }
+            desired = Pack(elem->next.load(std::memory_order_relaxed), old);
+        } while (!top.compare_exchange_weak(old, desired,
+            std::memory_order_acquire, std::memory_order_acquire));
+        return CastPolicy::FromNode(elem);
+    }
+
+    bool Empty() const noexcept
+    {
+        return (top.load(std::memory_order_relaxed) & PointerMask) == 0;
+    }
+private:
+    using LinkType = AtomicSListNode<>*;
+
+    static auto Pack(LinkType ptr, std::uint64_t old) noexcept -> std::uint64_t
+    {
+        return (reinterpret_cast<std::uintptr_t>(ptr) & PointerMask) | ((old & ~PointerMask) + TagOne);
+    }
+
+    static auto Unpack(std::uint64_t value) noexcept -> LinkType
+    {
+        auto addr = std::int64_t(value << (64 - PointerBits)) >> (64 - PointerBits);
+        return reinterpret_cast<LinkType>(addr);
+    }
+
+    std::atomic<std::uint64_t> top;
+};
+
+}
+
+#endif // ATOMIC_STACK_H
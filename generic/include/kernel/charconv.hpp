@@ -0,0 +1,130 @@
+#ifndef KERNEL_CHARCONV_HPP
+#define KERNEL_CHARCONV_HPP
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include "util.hpp"
+
+namespace kernel {
+
+enum class ConvStatus {
+    Ok,
+    InvalidArgument,
+    ValueTooLarge,
+};
+
+struct ToCharsResult {
+    char* ptr;
+    ConvStatus status;
+};
+
+struct FromCharsResult {
+    const char* ptr;
+    ConvStatus status;
+};
+
+namespace charconv_detail {
+
+extern const char LowerDigits[];
+extern const char UpperDigits[];
+
+auto ToChars(char* first, char* last, std::uint64_t value, int base,
+    const char* digits) -> ToCharsResult;
+auto ToChars(char* first, char* last, uint128_t value, int base,
+    const char* digits) -> ToCharsResult;
+
+auto FromChars(const char* first, const char* last, std::uint64_t& value,
+    int base) -> FromCharsResult;
+auto FromChars(const char* first, const char* last, uint128_t& value,
+    int base) -> FromCharsResult;
+
+template <typename T>
+concept Integer = (std::integral<T> && !std::same_as<T, bool>) ||
+    std::same_as<T, uint128_t> || std::same_as<T, int128_t>;
+
+template <typename T>
+constexpr bool IsSigned = std::same_as<T, int128_t> || std::is_signed_v<T>;
+
+template <typename T>
+using Wide = std::conditional_t<(sizeof(T) > 8), uint128_t, std::uint64_t>;
+
+// std::numeric_limits has no __int128 specialisation in strict ISO mode
+template <typename T>
+constexpr Wide<T> MaxValue = Wide<T>(std::numeric_limits<T>::max());
+
+template <>
+constexpr uint128_t MaxValue<uint128_t> = ~uint128_t(0);
+
+template <>
+constexpr uint128_t MaxValue<int128_t> = ~uint128_t(0) >> 1;
+
+} // namespace charconv_detail
+
+/**
+ * Writes value in the given base (2 to 36) into [first, last) without a
+ * terminating zero. On overflow returns {last, ValueTooLarge} and the
+ * contents of the range are unspecified.
+ */
+template <charconv_detail::Integer T>
+auto to_chars(char* first, char* last, T value, int base = 10) -> ToCharsResult
+{
+    using U = charconv_detail::Wide<T>;
+    U magnitude = U(value);
+    if constexpr (charconv_detail::IsSigned<T>) {
+        if (value < 0) {
+            if (first == last) {
+                return { last, ConvStatus::ValueTooLarge };
+            }
+            *first++ = '-';
+            magnitude = U(0) - magnitude;
+        }
+    }
+    return charconv_detail::ToChars(first, last, magnitude, base,
+        charconv_detail::LowerDigits);
+}
+
+/**
+ * Parses an integer in the given base (2 to 36) from [first, last).
+ * Signed types accept a leading '-'. No prefixes or whitespace are skipped.
+ * On failure value is left unmodified.
+ */
+template <charconv_detail::Integer T>
+auto from_chars(const char* first, const char* last, T& value, int base = 10) -> FromCharsResult
+{
+    using U = charconv_detail::Wide<T>;
+    bool negative = false;
+    auto begin = first;
+    if constexpr (charconv_detail::IsSigned<T>) {
+        if (first != last && *first == '-') {
+            negative = true;
+            ++first;
+        }
+    }
+    U magnitude;
+    auto result = charconv_detail::FromChars(first, last, magnitude, base);
+    if (result.status == ConvStatus::InvalidArgument) {
+        return { begin, result.status };
+    }
+    if (result.status != ConvStatus::Ok) {
+        return result;
+    }
+    if constexpr (charconv_detail::IsSigned<T>) {
+        if (magnitude > charconv_detail::MaxValue<T> + negative) {
+            return { result.ptr, ConvStatus::ValueTooLarge };
+        }
+        value = T(negative ? U(0) - magnitude : magnitude);
+    } else {
+        if (magnitude > charconv_detail::MaxValue<T>) {
+            return { result.ptr, ConvStatus::ValueTooLarge };
+        }
+        value = T(magnitude);
+    }
+    return result;
+}
+
+} // namespace kernel
+
+#endif // KERNEL_CHARCONV_HPP
@@ -0,0 +1,57 @@
+#ifndef KERNEL_CPU_HPP
+#define KERNEL_CPU_HPP
+
+namespace kernel {
+
+#ifdef KERNEL_UNIPROCESSOR
+constexpr unsigned MaxCPUs = 1;
+#else
+constexpr unsigned MaxCPUs = 64;
+#endif
+
+/**
+ * Generic part of a CPU's private data block. The platform places it at the
+ * start of its own per-CPU block; self must point to the block itself.
+ */
+struct CPU {
+    CPU* self;
+    unsigned index;
+};
+
+/**
+ * Data block of the CPU the caller runs on, a single GS relative load. A
+ * thread that can be preempted may move to another CPU right after.
+ */
+inline auto this_cpu() noexcept -> CPU&
+{
+#if defined(__x86_64__)
+    CPU* cpu;
+    asm volatile("movq %%gs:0, %0":"=r"(cpu));
+    return *cpu;
+#else
+#error "this_cpu() is not implemented for this architecture"
+#endif
+}
+
+/**
+ * Spin-wait hint for busy loops polling memory written by other CPUs.
+ */
+inline void CPURelax() noexcept
+{
+#if defined(__x86_64__)
+    asm volatile("pause":::"memory");
+#else
+#error "CPURelax() is not implemented for this architecture"
+#endif
+}
+
+/**
+ * Number of CPUs brought online, their indices are dense from 0.
+ * Implemented by the platform.
+ */
+auto CPUCount() noexcept -> unsigned;
+auto GetCPU(unsigned index) noexcept -> CPU&;
+
+} // namespace kernel
+
+#endif // KERNEL_CPU_HPP
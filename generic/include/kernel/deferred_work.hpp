@@ -0,0 +1,69 @@
+#ifndef KERNEL_DEFERRED_WORK_HPP
+#define KERNEL_DEFERRED_WORK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include "list.hpp"
+
+namespace kernel {
+
+/**
+ * Work item queued from interrupt context and run later with interrupts
+ * enabled. Scheduling an item that is already pending only increments its
+ * request count, so a burst of interrupts collapses into one call that
+ * receives the number of requests it covers.
+ */
+class DeferredWork : public intrusive::ListNode<> {
+public:
+    using Function = void (*)(void* ctx, std::uint32_t count);
+
+    constexpr DeferredWork(Function fn, void* ctx) noexcept :
+        ListNode{},
+        fn(fn),
+        ctx(ctx),
+        inboxNext(nullptr),
+        requests(0)
+    {}
+
+    DeferredWork(const DeferredWork&) = delete;
+    DeferredWork& operator=(const DeferredWork&) = delete;
+
+    /**
+     * Safe from any context except NMI, the first item queued kicks the
+     * bootstrap processor. Returns true if the item was queued, false if it
+     * was already pending.
+     */
+    bool Schedule() noexcept;
+
+    bool Pending() const noexcept
+    {
+        return requests.load(std::memory_order_relaxed) != 0;
+    }
+private:
+    friend auto RunDeferredWork(unsigned budget) noexcept -> bool;
+    friend bool DeferredWorkPending() noexcept;
+
+    Function fn;
+    void* ctx;
+    DeferredWork* inboxNext;
+    std::atomic<std::uint32_t> requests;
+};
+
+/**
+ * Runs up to budget pending items in FIFO order and returns true if work
+ * is left. Bootstrap processor only, from its outermost interrupts and its
+ * idle thread; a call made while another one runs returns false at once.
+ */
+auto RunDeferredWork(unsigned budget) noexcept -> bool;
+bool DeferredWorkPending() noexcept;
+
+/**
+ * Implemented by the platform: makes the bootstrap processor take an
+ * interrupt that runs deferred work. Returns false if it can't yet, the
+ * caller then runs the work itself or leaves it to the idle thread.
+ */
+auto KickDeferredWork() noexcept -> bool;
+
+} // namespace kernel
+
+#endif // KERNEL_DEFERRED_WORK_HPP
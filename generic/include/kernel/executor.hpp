@@ -0,0 +1,178 @@
+#ifndef KERNEL_EXECUTOR_HPP
+#define KERNEL_EXECUTOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include "cpu.hpp"
+
+namespace kernel {
+
+namespace executor_detail {
+
+struct Executor;
+
+} // namespace executor_detail
+
+/**
+ * Unit of fork-join work. Tasks run on whichever CPU gets to them first,
+ * with interrupts enabled; they must not block or throw. The object must
+ * stay alive until join() on it returns.
+ */
+class Task {
+public:
+    using Function = void (*)(void* ctx);
+
+    constexpr Task(Function fn, void* ctx) noexcept :
+        fn(fn),
+        ctx(ctx),
+        done(false)
+    {}
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool Done() const noexcept
+    {
+        return done.load(std::memory_order_acquire);
+    }
+private:
+    friend struct executor_detail::Executor;
+
+    Function fn;
+    void* ctx;
+    std::atomic<bool> done;
+};
+
+/**
+ * Queues task on the current CPU's deque where idle CPUs can steal it. Runs
+ * it right away when only one CPU is online or the deque is full. Callable
+ * from threads and tasks, not from interrupt handlers.
+ */
+void spawn(Task& task) noexcept;
+
+/**
+ * Returns once task has finished, running queued and stolen tasks in the
+ * meantime. Must be called on the CPU that spawned task.
+ */
+void join(Task& task) noexcept;
+
+/**
+ * Worker loop of application processors: runs stolen tasks and halts when
+ * there is nothing to steal.
+ */
+[[noreturn]] void RunExecutor() noexcept;
+
+/**
+ * Implemented by the platform: interrupts the other CPUs so that ones
+ * halted in RunExecutor() look for work again.
+ */
+void WakeIdleCPUs() noexcept;
+
+namespace executor_detail {
+
+auto DefaultGrain(std::size_t count) noexcept -> std::size_t;
+
+template <typename Fn>
+struct ForJob {
+    Fn* fn;
+    std::size_t begin;
+    std::size_t end;
+    std::size_t grain;
+};
+
+template <typename Fn>
+void For(Fn& fn, std::size_t begin, std::size_t end, std::size_t grain)
+{
+    if (end - begin <= grain) {
+        fn(begin, end);
+        return;
+    }
+    auto mid = begin + (end - begin) / 2;
+    ForJob<Fn> right{ &fn, mid, end, grain };
+    Task task{ [](void* ctx) {
+        auto& job = *static_cast<ForJob<Fn>*>(ctx);
+        For(*job.fn, job.begin, job.end, job.grain);
+    }, &right };
+    spawn(task);
+    For(fn, begin, mid, grain);
+    join(task);
+}
+
+template <typename T, typename Map, typename Combine>
+struct ReduceJob {
+    Map* map;
+    Combine* combine;
+    std::size_t begin;
+    std::size_t end;
+    std::size_t grain;
+    T result;
+};
+
+template <typename T, typename Map, typename Combine>
+auto Reduce(Map& map, Combine& combine, std::size_t begin, std::size_t end, std::size_t grain,
+    const T& init) -> T
+{
+    if (end - begin <= grain) {
+        return map(begin, end);
+    }
+    auto mid = begin + (end - begin) / 2;
+    ReduceJob<T, Map, Combine> right{ &map, &combine, mid, end, grain, init };
+    Task task{ [](void* ctx) {
+        auto& job = *static_cast<ReduceJob<T, Map, Combine>*>(ctx);
+        job.result = Reduce<T>(*job.map, *job.combine, job.begin, job.end, job.grain, job.result);
+    }, &right };
+    spawn(task);
+    auto left = Reduce<T>(map, combine, begin, mid, grain, init);
+    join(task);
+    return combine(std::move(left), std::move(right.result));
+}
+
+} // namespace executor_detail
+
+/**
+ * Calls fn(lo, hi) on disjoint subranges covering [begin, end), at most
+ * grain indices each, spread over the online CPUs. A grain of 0 picks one
+ * from the range size and CPU count. On a single CPU fn gets the whole
+ * range at once.
+ */
+template <typename Fn>
+void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, Fn&& fn)
+{
+    if (begin >= end) {
+        return;
+    }
+    if (CPUCount() == 1) {
+        fn(begin, end);
+        return;
+    }
+    if (grain == 0) {
+        grain = executor_detail::DefaultGrain(end - begin);
+    }
+    executor_detail::For(fn, begin, end, grain);
+}
+
+/**
+ * Splits [begin, end) like parallel_for and folds map(lo, hi) results of
+ * the subranges with combine(left, right) in index order. Returns init for
+ * an empty range.
+ */
+template <typename T, typename Map, typename Combine>
+auto parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, T init, Map&& map,
+    Combine&& combine) -> T
+{
+    if (begin >= end) {
+        return init;
+    }
+    if (CPUCount() == 1) {
+        return map(begin, end);
+    }
+    if (grain == 0) {
+        grain = executor_detail::DefaultGrain(end - begin);
+    }
+    return executor_detail::Reduce<T>(map, combine, begin, end, grain, init);
+}
+
+} // namespace kernel
+
+#endif // KERNEL_EXECUTOR_HPP
@@ -0,0 +1,362 @@
+#ifndef KERNEL_FORMAT_HPP
+#define KERNEL_FORMAT_HPP
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace kernel {
+
+/**
+ * Argument wrapper that prints a memory block as space separated hex bytes
+ */
+struct HexDump {
+    const void* data;
+    std::size_t size;
+};
+
+namespace format_detail {
+
+enum class ArgKind : unsigned char {
+    None,
+    Bool,
+    Char,
+    Signed,
+    Unsigned,
+    Pointer,
+    String,
+    HexDump,
+};
+
+enum class Presentation : unsigned char {
+    Default,
+    Decimal,
+    HexLower,
+    HexUpper,
+    Octal,
+    Binary,
+    Char,
+    String,
+    Pointer,
+};
+
+struct Spec {
+    Presentation type = Presentation::Default;
+    bool alternate = false;
+    bool zeroPad = false;
+    unsigned char width = 0;
+};
+
+struct Segment {
+    unsigned short literalOffset;
+    unsigned short literalSize;
+    short arg;
+    Spec spec;
+};
+
+template <typename T>
+consteval auto KindOf() -> ArgKind
+{
+    if constexpr (std::same_as<T, bool>) {
+        return ArgKind::Bool;
+    } else if constexpr (std::same_as<T, char>) {
+        return ArgKind::Char;
+    } else if constexpr (std::signed_integral<T>) {
+        return ArgKind::Signed;
+    } else if constexpr (std::unsigned_integral<T>) {
+        return ArgKind::Unsigned;
+    } else if constexpr (std::is_enum_v<T>) {
+        return KindOf<std::underlying_type_t<T>>();
+    } else if constexpr (
+        std::same_as<T, const char*> || std::same_as<T, char*> ||
+        std::same_as<T, std::string_view>
+    ) {
+        return ArgKind::String;
+    } else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>) {
+        return ArgKind::Pointer;
+    } else if constexpr (std::same_as<T, HexDump>) {
+        return ArgKind::HexDump;
+    } else {
+        return ArgKind::None;
+    }
+}
+
+// Not constexpr: reaching it during constant evaluation is the diagnostic
+inline void FormatError(const char*) {}
+
+consteval bool Accepts(ArgKind kind, Presentation type)
+{
+    switch (type) {
+    case Presentation::Default:
+        return true;
+    case Presentation::Decimal:
+    case Presentation::Octal:
+    case Presentation::Binary:
+        return kind == ArgKind::Signed || kind == ArgKind::Unsigned ||
+            kind == ArgKind::Char || kind == ArgKind::Bool;
+    case Presentation::HexLower:
+    case Presentation::HexUpper:
+        return kind == ArgKind::Signed || kind == ArgKind::Unsigned ||
+            kind == ArgKind::Char || kind == ArgKind::Bool ||
+            kind == ArgKind::Pointer || kind == ArgKind::HexDump;
+    case Presentation::Char:
+        return kind == ArgKind::Char || kind == ArgKind::Signed ||
+            kind == ArgKind::Unsigned;
+    case Presentation::String:
+        return kind == ArgKind::String || kind == ArgKind::Bool;
+    case Presentation::Pointer:
+        return kind == ArgKind::Pointer;
+    }
+    return false;
+}
+
+struct Arg {
+    ArgKind kind;
+    union {
+        std::uint64_t u;
+        std::int64_t i;
+        const void* p;
+        std::string_view s;
+        HexDump h;
+    };
+};
+
+template <typename T>
+auto MakeArg(const T& value) -> Arg
+{
+    using D = std::decay_t<T>;
+    constexpr auto kind = KindOf<D>();
+    Arg arg{ kind, {} };
+    if constexpr (std::is_enum_v<D>) {
+        if constexpr (kind == ArgKind::Signed) {
+            arg.i = static_cast<std::int64_t>(value);
+        } else {
+            arg.u = static_cast<std::uint64_t>(value);
+        }
+    } else if constexpr (kind == ArgKind::Bool || kind == ArgKind::Unsigned) {
+        arg.u = value;
+    } else if constexpr (kind == ArgKind::Char) {
+        arg.u = static_cast<unsigned char>(value);
+    } else if constexpr (kind == ArgKind::Signed) {
+        arg.i = value;
+    } else if constexpr (kind == ArgKind::String) {
+        if constexpr (std::same_as<D, std::string_view>) {
+            arg.s = value;
+        } else {
+            arg.s = value != nullptr ? std::string_view(value) : std::string_view("(null)");
+        }
+    } else if constexpr (kind == ArgKind::Pointer) {
+        arg.p = static_cast<const void*>(value);
+    } else {
+        arg.h = value;
+    }
+    return arg;
+}
+
+struct Writer {
+    char* cur;
+    char* end;
+
+    void Put(char ch)
+    {
+        if (cur != end) {
+            *cur++ = ch;
+        }
+    }
+
+    void Put(const char* str, std::size_t size);
+
+    void Pad(char ch, std::size_t count)
+    {
+        while (count-- != 0) {
+            Put(ch);
+        }
+    }
+};
+
+void WriteArg(Writer& out, const Arg& arg, Spec spec);
+
+void Format(Writer& out, const char* fmt, const Segment* segments,
+    std::size_t segCount, const Arg* args);
+
+} // namespace format_detail
+
+/**
+ * Format string checked against its argument types at compile time.
+ *
+ * Syntax is a subset of std::format: "{}" takes the next argument and
+ * "{:[#][0][width][type]}" selects the presentation, where type is one of
+ * d, x, X, o, b, c, s, p. "{{" and "}}" print literal braces.
+ */
+template <typename ... Args>
+class FormatString {
+    using Segment = format_detail::Segment;
+    static constexpr std::size_t MaxEscapes = 8;
+public:
+    static constexpr std::size_t MaxSegments = 2 * sizeof...(Args) + 1 + MaxEscapes;
+
+    template <std::size_t N>
+    consteval FormatString(const char (&str)[N]) :
+        str(str),
+        segments{},
+        segCount(0)
+    {
+        Parse(std::string_view(str, N - 1));
+    }
+
+    consteval FormatString(std::string_view str) :
+        str(str.data()),
+        segments{},
+        segCount(0)
+    {
+        Parse(str);
+    }
+
+    const char* str;
+    Segment segments[MaxSegments];
+    std::size_t segCount;
+private:
+    static constexpr format_detail::ArgKind kinds[sizeof...(Args) + 1] = {
+        format_detail::KindOf<Args>()..., format_detail::ArgKind::None
+    };
+
+    consteval void Push(std::size_t litBegin, std::size_t litEnd, int arg,
+        format_detail::Spec spec)
+    {
+        if (segCount == MaxSegments) {
+            format_detail::FormatError("too many escaped braces in format string");
+        }
+        if (litEnd > 0xFFFF) {
+            format_detail::FormatError("format string too long");
+        }
+        segments[segCount++] = {
+            (unsigned short)litBegin, (unsigned short)(litEnd - litBegin),
+            (short)arg, spec
+        };
+    }
+
+    consteval auto ParseSpec(std::string_view fmt, std::size_t pos,
+        format_detail::Spec& spec) -> std::size_t
+    {
+        using format_detail::Presentation;
+        if (pos < fmt.size() && fmt[pos] == '#') {
+            spec.alternate = true;
+            ++pos;
+        }
+        if (pos < fmt.size() && fmt[pos] == '0') {
+            spec.zeroPad = true;
+            ++pos;
+        }
+        unsigned width = 0;
+        while (pos < fmt.size() && fmt[pos] >= '0' && fmt[pos] <= '9') {
+            width = width * 10 + unsigned(fmt[pos++] - '0');
+            if (width > 255) {
+                format_detail::FormatError("field width too large");
+            }
+        }
+        spec.width = (unsigned char)width;
+        if (pos < fmt.size() && fmt[pos] != '}') {
+            switch (fmt[pos++]) {
+            case 'd': spec.type = Presentation::Decimal; break;
+            case 'x': spec.type = Presentation::HexLower; break;
+            case 'X': spec.type = Presentation::HexUpper; break;
+            case 'o': spec.type = Presentation::Octal; break;
+            case 'b': spec.type = Presentation::Binary; break;
+            case 'c': spec.type = Presentation::Char; break;
+            case 's': spec.type = Presentation::String; break;
+            case 'p': spec.type = Presentation::Pointer; break;
+            default:
+                format_detail::FormatError("unknown presentation type");
+            }
+        }
+        if (pos == fmt.size() || fmt[pos] != '}') {
+            format_detail::FormatError("unterminated replacement field");
+        }
+        return pos;
+    }
+
+    consteval void Parse(std::string_view fmt)
+    {
+        std::size_t litBegin = 0;
+        std::size_t argIndex = 0;
+        for (std::size_t i = 0; i < fmt.size(); ++i) {
+            if (fmt[i] == '}') {
+                if (i + 1 == fmt.size() || fmt[i + 1] != '}') {
+                    format_detail::FormatError("unmatched '}' in format string");
+                }
+                Push(litBegin, i + 1, -1, {});
+                litBegin = ++i + 1;
+                continue;
+            }
+            if (fmt[i] != '{') {
+                continue;
+            }
+            if (i + 1 < fmt.size() && fmt[i + 1] == '{') {
+                Push(litBegin, i + 1, -1, {});
+                litBegin = ++i + 1;
+                continue;
+            }
+            format_detail::Spec spec;
+            auto end = i + 1;
+            if (end < fmt.size() && fmt[end] == ':') {
+                end = ParseSpec(fmt, end + 1, spec);
+            } else if (end == fmt.size() || fmt[end] != '}') {
+                format_detail::FormatError("positional arguments are not supported");
+            }
+            if (argIndex == sizeof...(Args)) {
+                format_detail::FormatError("not enough arguments for format string");
+            }
+            if (kinds[argIndex] == format_detail::ArgKind::None) {
+                format_detail::FormatError("argument type is not formattable");
+            }
+            if (!format_detail::Accepts(kinds[argIndex], spec.type)) {
+                format_detail::FormatError("presentation type does not match argument");
+            }
+            Push(litBegin, i, int(argIndex++), spec);
+            litBegin = end + 1;
+            i = end;
+        }
+        if (argIndex != sizeof...(Args)) {
+            format_detail::FormatError("too many arguments for format string");
+        }
+        if (litBegin != fmt.size()) {
+            Push(litBegin, fmt.size(), -1, {});
+        }
+    }
+};
+
+template <typename ... Args>
+using FormatStringFor = FormatString<std::type_identity_t<std::decay_t<Args>>...>;
+
+/**
+ * Formats into [buf, buf + size), truncating on overflow. Returns the number
+ * of characters written; no terminating zero is appended.
+ */
+template <typename ... Args>
+auto format_to(char* buf, std::size_t size, FormatStringFor<Args...> fmt,
+    const Args& ... args) -> std::size_t
+{
+    format_detail::Writer out{ buf, buf + size };
+    if constexpr (sizeof...(Args) == 0) {
+        format_detail::Format(out, fmt.str, fmt.segments, fmt.segCount, nullptr);
+    } else {
+        const format_detail::Arg argArray[] = {
+            format_detail::MakeArg(args)...
+        };
+        format_detail::Format(out, fmt.str, fmt.segments, fmt.segCount, argArray);
+    }
+    return std::size_t(out.cur - buf);
+}
+
+template <std::size_t N, typename ... Args>
+auto format_to(char (&buf)[N], FormatStringFor<Args...> fmt,
+    const Args& ... args) -> std::size_t
+{
+    return format_to<Args...>(buf, N, fmt, args...);
+}
+
+} // namespace kernel
+
+#endif // KERNEL_FORMAT_HPP
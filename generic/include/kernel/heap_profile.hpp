@@ -0,0 +1,31 @@
+#ifndef KERNEL_HEAP_PROFILE_HPP
+#define KERNEL_HEAP_PROFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kernel {
+
+#ifdef KERNEL_HEAP_PROFILE
+/**
+ * Charges an allocation of size bytes at ptr to the call site it was made
+ * from. Allocations are also sampled about once per HeapSampleBytes bytes
+ * allocated, each byte equally likely, and a sampled one keeps its stack
+ * trace until freed. Returns true if this one was sampled; the allocator
+ * must pass that back to HeapProfileFree().
+ */
+bool HeapProfileAlloc(void* ptr, std::size_t size, std::uintptr_t site) noexcept;
+void HeapProfileFree(void* ptr, std::size_t size, std::uintptr_t site, bool sampled) noexcept;
+
+/**
+ * Prints the call sites holding the most live bytes, then the stack traces
+ * of the sampled allocations still live, to the debug port.
+ */
+void DumpHeapProfile() noexcept;
+
+constexpr std::uint64_t HeapSampleBytes = 512 * 1024;
+#endif
+
+} // namespace kernel
+
+#endif // KERNEL_HEAP_PROFILE_HPP
@@ -0,0 +1,113 @@
+#ifndef KERNEL_HISTOGRAM_HPP
+#define KERNEL_HISTOGRAM_HPP
+
+#include <bit>
+#include <cstdint>
+
+namespace kernel {
+
+/**
+ * Fixed size log-linear histogram: each power of two range is split into
+ * 2^SubBucketBits linear buckets, so any recorded value is reported within
+ * a relative error of 2^-SubBucketBits. Values of RangeBits bits and more
+ * share the last bucket; Max() still reports them exactly. Not thread
+ * safe, callers serialise Record().
+ */
+template <unsigned SubBucketBits, unsigned RangeBits>
+class LogHistogram {
+    static_assert(SubBucketBits > 0 && SubBucketBits < RangeBits && RangeBits <= 64);
+
+    static constexpr unsigned SubBuckets = 1U << SubBucketBits;
+public:
+    static constexpr unsigned BucketCount = (RangeBits - SubBucketBits + 1) * SubBuckets;
+
+    constexpr LogHistogram() noexcept :
+        buckets{},
+        count(0),
+        sum(0),
+        min(0),
+        max(0)
+    {}
+
+    static constexpr auto BucketIndex(std::uint64_t value) noexcept -> unsigned
+    {
+        if (value < SubBuckets) {
+            return unsigned(value);
+        }
+        unsigned exponent = std::bit_width(value) - 1;
+        if (exponent >= RangeBits) {
+            return BucketCount - 1;
+        }
+        unsigned block = exponent - SubBucketBits + 1;
+        auto sub = unsigned(value >> (block - 1)) & (SubBuckets - 1);
+        return block * SubBuckets + sub;
+    }
+
+    static constexpr auto BucketLow(unsigned index) noexcept -> std::uint64_t
+    {
+        unsigned block = index / SubBuckets;
+        std::uint64_t sub = index % SubBuckets;
+        if (block == 0) {
+            return sub;
+        }
+        return (SubBuckets + sub) << (block - 1);
+    }
+
+    static constexpr auto BucketHigh(unsigned index) noexcept -> std::uint64_t
+    {
+        unsigned block = index / SubBuckets;
+        return BucketLow(index) + (block == 0 ? 0 : (std::uint64_t(1) << (block - 1)) - 1);
+    }
+
+    void Record(std::uint64_t value) noexcept
+    {
+        ++buckets[BucketIndex(value)];
+        ++count;
+        sum += value;
+        min = count == 1 || value < min ? value : min;
+        max = value > max ? value : max;
+    }
+
+    void Reset() noexcept
+    {
+        *this = LogHistogram{};
+    }
+
+    /**
+     * Upper bound of the bucket holding the given fraction, in permille, of
+     * recorded values; 0 when empty.
+     */
+    auto Percentile(unsigned permille) const noexcept -> std::uint64_t
+    {
+        if (count == 0) {
+            return 0;
+        }
+        auto rank = (count * permille + 999) / 1000;
+        rank = rank == 0 ? 1 : rank;
+        std::uint64_t seen = 0;
+        for (unsigned i = 0; i < BucketCount; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                auto high = BucketHigh(i);
+                return high < max ? high : max;
+            }
+        }
+        return max;
+    }
+
+    auto Count() const noexcept -> std::uint64_t { return count; }
+    auto Sum() const noexcept -> std::uint64_t { return sum; }
+    auto Min() const noexcept -> std::uint64_t { return min; }
+    auto Max() const noexcept -> std::uint64_t { return max; }
+    auto Bucket(unsigned index) const noexcept -> std::uint32_t { return buckets[index]; }
+private:
+    std::uint32_t buckets[BucketCount];
+    std::uint64_t count;
+    std::uint64_t sum;
+    std::uint64_t min;
+    std::uint64_t max;
+};
+
+} // namespace kernel
+
+#endif // KERNEL_HISTOGRAM_HPP
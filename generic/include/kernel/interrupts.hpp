@@ -0,0 +1,44 @@
+#ifndef KERNEL_INTERRUPTS_HPP
+#define KERNEL_INTERRUPTS_HPP
+
+#include <cstdint>
+
+namespace kernel {
+
+using InterruptState = std::uintptr_t;
+
+/**
+ * Disables interrupts on the current CPU and returns the previous state for
+ * RestoreInterrupts(). Implemented by the platform.
+ */
+auto SaveAndDisableInterrupts() noexcept -> InterruptState;
+void RestoreInterrupts(InterruptState state) noexcept;
+void EnableInterrupts() noexcept;
+
+/**
+ * Enables interrupts and halts until one has been handled. The check that
+ * led to waiting can be made with interrupts disabled without missing a
+ * wakeup. Implemented by the platform.
+ */
+void WaitForInterrupt() noexcept;
+
+class InterruptGuard {
+public:
+    InterruptGuard() noexcept :
+        state(SaveAndDisableInterrupts())
+    {}
+
+    InterruptGuard(const InterruptGuard&) = delete;
+    InterruptGuard& operator=(const InterruptGuard&) = delete;
+
+    ~InterruptGuard()
+    {
+        RestoreInterrupts(state);
+    }
+private:
+    InterruptState state;
+};
+
+} // namespace kernel
+
+#endif // KERNEL_INTERRUPTS_HPP
@@ -0,0 +1,61 @@
+#ifndef KERNEL_JUMP_LABEL_HPP
+#define KERNEL_JUMP_LABEL_HPP
+
+#include <cstdint>
+
+namespace kernel {
+
+/**
+ * Boolean switch for branches tested through StaticKeyEnabled(). Keys must
+ * be objects with static storage duration; they start out disabled.
+ */
+struct StaticKey {
+    bool enabled;
+};
+
+namespace jump_label_detail {
+
+// One per StaticKeyEnabled() site in the __jump_table section, every
+// field relative to its own address
+struct Entry {
+    std::int32_t code;
+    std::int32_t target;
+    std::int64_t key;
+};
+
+} // namespace jump_label_detail
+
+/**
+ * Compiles to a single 5-byte NOP that SetStaticKey() rewrites into a jump
+ * to the code returning true, so the disabled branch costs no load or
+ * compare.
+ */
+[[gnu::always_inline]] inline bool StaticKeyEnabled(const StaticKey& key) noexcept
+{
+#if defined(__x86_64__)
+    asm goto(
+        "1: .byte 0x0f, 0x1f, 0x44, 0x00, 0x00\n"
+        ".pushsection __jump_table, \"a\"\n"
+        ".balign 8\n"
+        ".long 1b - ., %l[enabled] - .\n"
+        ".quad %c0 - .\n"
+        ".popsection\n"
+        : : "i"(&key) : : enabled);
+    return false;
+enabled:
+    return true;
+#else
+#error "StaticKeyEnabled() is not implemented for this architecture"
+#endif
+}
+
+/**
+ * Implemented by the platform: patches every site testing key while the
+ * other CPUs wait in an interrupt handler. Slow, for thread context only
+ * and never with a spinlock held.
+ */
+void SetStaticKey(StaticKey& key, bool enabled) noexcept;
+
+} // namespace kernel
+
+#endif // KERNEL_JUMP_LABEL_HPP
@@ -45,7 +45,7 @@ public:
         NodeType* ptr;
     };
 
-    List() noexcept {
+    constexpr List() noexcept {
         Clear();
     }
 
@@ -130,7 +130,7 @@ public:
         return (Begin() == End());
     }
 
-    void Clear() noexcept
+    constexpr void Clear() noexcept
     {
         using Tr = NodeTraits;
         Tr::SetPrev(sentinel, std::addressof(sentinel));
@@ -22,16 +22,16 @@ template <typename T>
 struct ListNodeTraits<ListNode<T>> {
     using NodeType = ListNode<T>;
     using SentinelType = ListNode<T>;
-    static auto GetNext(NodeType& node) -> NodeType* {
+    static constexpr auto GetNext(NodeType& node) -> NodeType* {
         return node.next;
     }
-    static void SetNext(NodeType& node, NodeType* next) {
+    static constexpr void SetNext(NodeType& node, NodeType* next) {
         node.next = next;
     }
-    static auto GetPrev(NodeType& node) -> NodeType* {
+    static constexpr auto GetPrev(NodeType& node) -> NodeType* {
         return node.prev;
     }
-    static void SetPrev(NodeType& node, NodeType* prev) {
+    static constexpr void SetPrev(NodeType& node, NodeType* prev) {
         node.prev = prev;
     }
 };
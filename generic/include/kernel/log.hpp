@@ -0,0 +1,90 @@
+#ifndef KERNEL_LOG_HPP
+#define KERNEL_LOG_HPP
+
+#include <cstddef>
+#include <string_view>
+#include "format.hpp"
+
+#ifndef KERNEL_LOG_LEVEL
+#define KERNEL_LOG_LEVEL 2
+#endif
+
+namespace kernel {
+
+enum class LogLevel {
+    Error,
+    Warning,
+    Info,
+    Debug,
+};
+
+/**
+ * Most verbose level compiled in, set by the KERNEL_LOG_LEVEL build option.
+ * LOG_* statements above it compile to nothing, arguments included.
+ */
+constexpr auto MaxLogLevel = LogLevel(KERNEL_LOG_LEVEL);
+
+namespace log_detail {
+
+constexpr std::size_t MaxLine = 160;
+
+void Write(std::string_view line) noexcept;
+
+} // namespace log_detail
+
+/**
+ * Formats a line into the current CPU's log ring, a copy under disabled
+ * interrupts with no shared writes. The rings are emptied into the log
+ * sink from the idle loops and from deferred work, so output lags behind.
+ * Lines longer than MaxLine are cut; lines that find the ring full are
+ * dropped and counted. Called through the LOG_* macros, which skip
+ * argument evaluation for levels above MaxLogLevel.
+ */
+template <LogLevel Level, typename ... Args>
+void Log(FormatStringFor<Args...> fmt, const Args& ... args) noexcept
+{
+    char buf[log_detail::MaxLine];
+    auto size = format_to<Args...>(buf, sizeof(buf) - 1, fmt, args...);
+    buf[size++] = '\n';
+    log_detail::Write({ buf, size });
+}
+
+/**
+ * Receives flushed log text, whole lines at a time.
+ */
+using LogSink = void (*)(std::string_view text);
+
+/**
+ * Replaces the sink, the debug port by default.
+ */
+void SetLogSink(LogSink sink) noexcept;
+
+/**
+ * Writes out the rings of all CPUs. Returns immediately if another CPU is
+ * already flushing.
+ */
+void FlushLog() noexcept;
+
+/**
+ * Writes text through the current CPU's ring like a log line, but flushes
+ * the ring when it is full instead of dropping anything. For dumps too
+ * large for a ring; text over half a ring may interleave with lines of
+ * other CPUs. Thread context only.
+ */
+void WriteLog(std::string_view text) noexcept;
+
+} // namespace kernel
+
+#define KERNEL_LOG(level, ...) \
+    do { \
+        if constexpr (::kernel::LogLevel::level <= ::kernel::MaxLogLevel) { \
+            ::kernel::Log<::kernel::LogLevel::level>(__VA_ARGS__); \
+        } \
+    } while (false)
+
+#define LOG_ERROR(...) KERNEL_LOG(Error, __VA_ARGS__)
+#define LOG_WARNING(...) KERNEL_LOG(Warning, __VA_ARGS__)
+#define LOG_INFO(...) KERNEL_LOG(Info, __VA_ARGS__)
+#define LOG_DEBUG(...) KERNEL_LOG(Debug, __VA_ARGS__)
+
+#endif // KERNEL_LOG_HPP
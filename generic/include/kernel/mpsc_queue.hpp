@@ -0,0 +1,99 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include "node.hpp"
+#include "slist_node.hpp"
+
+namespace kernel::intrusive {
+
+template <typename T, typename CastPolicyGen = BaseClassCastPolicy<AtomicSListNode<>, T>>
+class MPSCQueue;
+
+/**
+ * Dmitry Vyukov's intrusive multi-producer single-consumer FIFO. Push is
+ * one exchange and never waits, so it is safe from any CPU and from
+ * interrupt handlers; Pop and Empty must only be called by one consumer
+ * at a time.
+ * The queue can't be moved because it links to its own stub node.
+ */
+template <typename T, typename CastPolicyGen>
+class MPSCQueue : detail::ContainerNodeRequirments<T, CastPolicyGen> {
+    using CastPolicy = CastPolicyGen;
+    using NodeType = typename CastPolicy::NodeType;
+    using LinkType = AtomicSListNode<>*;
+public:
+    constexpr MPSCQueue() noexcept :
+        head(&stub),
+        tail(&stub),
+        stub{}
+    {}
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    void Push(T& ref) noexcept
+    {
+        PushNode(CastPolicy::ToNode(std::addressof(ref)));
+    }
+
+    /**
+     * Unlinks and returns the oldest item. Returns nullptr when the queue
+     * is empty and also, transiently, while a producer is between its
+     * exchange and its link store; the item shows up on a later call.
+     */
+    auto Pop() noexcept -> T*
+    {
+        auto first = tail;
+        auto next = first->next.load(std::memory_order_acquire);
+        if (first == &stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail = next;
+            return FromLink(first);
+        }
+        if (first != head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        // first is the only item, put the stub behind it to detach it
+        PushNode(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail = next;
+            return FromLink(first);
+        }
+        return nullptr;
+    }
+
+    bool Empty() const noexcept
+    {
+        return tail == &stub && stub.next.load(std::memory_order_acquire) == nullptr;
+    }
+private:
+    void PushNode(LinkType node) noexcept
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        auto prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    static auto FromLink(LinkType link) noexcept -> T*
+    {
+        return CastPolicy::FromNode(static_cast<NodeType*>(link));
+    }
+
+    std::atomic<LinkType> head;
+    LinkType tail;
+    AtomicSListNode<> stub;
+};
+
+}
+
+#endif // MPSC_QUEUE_H
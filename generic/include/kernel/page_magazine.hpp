@@ -0,0 +1,84 @@
+#ifndef KERNEL_PAGE_MAGAZINE_HPP
+#define KERNEL_PAGE_MAGAZINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace kernel {
+
+/**
+ * Stack of free single pages in front of a buddy allocator. A refill takes
+ * one block of Batch pages, falling back to single pages, and a drain
+ * returns the Batch oldest pages, so the allocator is reached once per
+ * batch rather than per page. Source provides AllocPages(level), alloc()
+ * and free(page), failing with Invalid. Not synchronised: the caller keeps
+ * other CPUs and interrupts off the magazine and the source.
+ */
+template <int BatchLevel, std::uint64_t PageSize>
+struct alignas(64) PageMagazine {
+    static constexpr std::ptrdiff_t Batch = std::ptrdiff_t(1) << BatchLevel;
+    static constexpr std::ptrdiff_t Capacity = Batch * 2;
+    static constexpr std::uint64_t Invalid = ~std::uint64_t(0);
+
+    std::ptrdiff_t count;
+    std::uint64_t pages[Capacity];
+
+    bool Empty() const
+    {
+        return count == 0;
+    }
+
+    bool Full() const
+    {
+        return count == Capacity;
+    }
+
+    auto Pop() -> std::uint64_t
+    {
+        return pages[--count];
+    }
+
+    void Push(std::uint64_t page)
+    {
+        pages[count++] = page;
+    }
+
+    // Returns false if the source had no page at all
+    template <typename Source>
+    bool Refill(Source& source)
+    {
+        auto block = source.AllocPages(BatchLevel);
+        if (block != Invalid) {
+            // Lowest address on top
+            for (auto i = Batch; i != 0;) {
+                --i;
+                Push(block + std::uint64_t(i) * PageSize);
+            }
+            return true;
+        }
+        while (count != Batch) {
+            auto page = source.alloc();
+            if (page == Invalid) {
+                break;
+            }
+            Push(page);
+        }
+        return count != 0;
+    }
+
+    // Needs at least Batch pages
+    template <typename Source>
+    void Drain(Source& source)
+    {
+        for (std::ptrdiff_t i = 0; i != Batch; ++i) {
+            source.free(pages[i]);
+        }
+        count -= Batch;
+        std::memmove(pages, pages + Batch, sizeof(pages[0]) * count);
+    }
+};
+
+} // namespace kernel
+
+#endif // KERNEL_PAGE_MAGAZINE_HPP
@@ -0,0 +1,155 @@
+#ifndef KERNEL_PERCPU_COUNTER_HPP
+#define KERNEL_PERCPU_COUNTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "cpu.hpp"
+
+namespace kernel {
+
+namespace percpu_detail {
+
+// Slots of different CPUs never share a cache line; with a single CPU there
+// is nothing to keep apart
+constexpr std::size_t SlotAlign = MaxCPUs > 1 ? 64 : alignof(std::uint64_t);
+
+/**
+ * Adds n to a slot only the current CPU writes. A single instruction, so an
+ * interrupt on this CPU can't split it, and no lock prefix since other CPUs
+ * only read.
+ */
+inline void LocalAdd(std::uint64_t& slot, std::uint64_t n) noexcept
+{
+#if defined(__x86_64__)
+    asm volatile("addq %1, %0":"+m"(slot):"er"(n));
+#else
+#error "LocalAdd() is not implemented for this architecture"
+#endif
+}
+
+inline auto RemoteRead(const std::uint64_t& slot) noexcept -> std::uint64_t
+{
+    return __atomic_load_n(&slot, __ATOMIC_RELAXED);
+}
+
+inline auto LocalIndex() noexcept -> unsigned
+{
+    if constexpr (MaxCPUs == 1) {
+        return 0;
+    } else {
+        return this_cpu().index;
+    }
+}
+
+} // namespace percpu_detail
+
+/**
+ * Event counter sharded into one slot per CPU. Add() touches only the
+ * current CPU's slot, Sum() adds up the slots of the online CPUs and may
+ * miss increments that race with it. Writers must not migrate between
+ * reading their CPU index and the add, which holds for every context in
+ * this kernel.
+ */
+class PerCpuCounter {
+public:
+    constexpr PerCpuCounter() noexcept :
+        slots{}
+    {}
+
+    PerCpuCounter(const PerCpuCounter&) = delete;
+    PerCpuCounter& operator=(const PerCpuCounter&) = delete;
+
+    void Add(std::uint64_t n = 1) noexcept
+    {
+        percpu_detail::LocalAdd(slots[percpu_detail::LocalIndex()].value, n);
+    }
+
+    auto Read(unsigned cpu) const noexcept -> std::uint64_t
+    {
+        return percpu_detail::RemoteRead(slots[cpu].value);
+    }
+
+    auto Sum() const noexcept -> std::uint64_t
+    {
+        if constexpr (MaxCPUs == 1) {
+            return Read(0);
+        } else {
+            std::uint64_t sum = 0;
+            auto count = CPUCount();
+            for (unsigned cpu = 0; cpu < count; ++cpu) {
+                sum += Read(cpu);
+            }
+            return sum;
+        }
+    }
+private:
+    struct alignas(percpu_detail::SlotAlign) Slot {
+        std::uint64_t value;
+    };
+
+    Slot slots[MaxCPUs];
+};
+
+/**
+ * A group of counters updated together, Stats being a struct of
+ * std::uint64_t fields. Each CPU owns a copy of the struct and Snapshot()
+ * returns their field-wise sum.
+ */
+template <typename Stats>
+class PerCpuStats {
+    static_assert(std::is_standard_layout_v<Stats> && std::is_trivially_copyable_v<Stats>);
+    static_assert(sizeof(Stats) % sizeof(std::uint64_t) == 0 && alignof(Stats) == alignof(std::uint64_t));
+
+    static constexpr std::size_t Fields = sizeof(Stats) / sizeof(std::uint64_t);
+public:
+    using Field = std::uint64_t Stats::*;
+
+    constexpr PerCpuStats() noexcept :
+        slots{}
+    {}
+
+    PerCpuStats(const PerCpuStats&) = delete;
+    PerCpuStats& operator=(const PerCpuStats&) = delete;
+
+    void Add(Field field, std::uint64_t n = 1) noexcept
+    {
+        percpu_detail::LocalAdd(slots[percpu_detail::LocalIndex()].value.*field, n);
+    }
+
+    auto Read(unsigned cpu) const noexcept -> Stats
+    {
+        Stats result{};
+        Accumulate(result, cpu);
+        return result;
+    }
+
+    auto Snapshot() const noexcept -> Stats
+    {
+        Stats result{};
+        auto count = MaxCPUs == 1 ? 1 : CPUCount();
+        for (unsigned cpu = 0; cpu < count; ++cpu) {
+            Accumulate(result, cpu);
+        }
+        return result;
+    }
+private:
+    void Accumulate(Stats& result, unsigned cpu) const noexcept
+    {
+        auto dst = reinterpret_cast<std::uint64_t*>(&result);
+        auto src = reinterpret_cast<const std::uint64_t*>(&slots[cpu].value);
+        for (std::size_t i = 0; i < Fields; ++i) {
+            dst[i] += percpu_detail::RemoteRead(src[i]);
+        }
+    }
+
+    struct alignas(percpu_detail::SlotAlign) Slot {
+        Stats value;
+    };
+
+    Slot slots[MaxCPUs];
+};
+
+} // namespace kernel
+
+#endif // KERNEL_PERCPU_COUNTER_HPP
@@ -0,0 +1,72 @@
+#ifndef KERNEL_RCU_HPP
+#define KERNEL_RCU_HPP
+
+#include <atomic>
+#include "interrupts.hpp"
+#include "slist_node.hpp"
+
+namespace kernel {
+
+/**
+ * Quiescent-state-based read-copy-update. Readers run with interrupts
+ * disabled and touch no shared memory; every point where a CPU can't be
+ * inside a read-side section (return from an outermost interrupt, a
+ * context switch, the idle loops) records that it has seen the current
+ * grace period in its own per-CPU slot. A node unlinked by a writer is
+ * handed to RCURetire() and its callback runs once every online CPU has
+ * passed such a point.
+ */
+class RCUReadGuard {
+public:
+    RCUReadGuard() noexcept = default;
+    RCUReadGuard(const RCUReadGuard&) = delete;
+    RCUReadGuard& operator=(const RCUReadGuard&) = delete;
+private:
+    InterruptGuard guard;
+};
+
+/**
+ * Embedded in nodes whose reclamation waits for a grace period.
+ */
+struct RCUHead : intrusive::SListNode<> {
+    using Function = void (*)(RCUHead* head);
+
+    Function fn;
+};
+
+template <typename T>
+auto RCUDereference(const std::atomic<T*>& ptr) noexcept -> T*
+{
+    return ptr.load(std::memory_order_acquire);
+}
+
+/**
+ * Publishes a fully initialised node to readers.
+ */
+template <typename T>
+void RCUAssign(std::atomic<T*>& ptr, T* value) noexcept
+{
+    ptr.store(value, std::memory_order_release);
+}
+
+/**
+ * Calls fn(&head) after a grace period, in timer context on the bootstrap
+ * processor. The node must already be unreachable for new readers.
+ * Callable from any context except a read-side section.
+ */
+void RCURetire(RCUHead& head, RCUHead::Function fn) noexcept;
+
+/**
+ * Blocks the calling thread until a full grace period has elapsed.
+ */
+void RCUSynchronize() noexcept;
+
+/**
+ * Called by the kernel on the current CPU at points that can't be inside a
+ * read-side section.
+ */
+void RCUQuiescentState() noexcept;
+
+} // namespace kernel
+
+#endif // KERNEL_RCU_HPP
@@ -0,0 +1,147 @@
+#ifndef KERNEL_SEQLOCK_HPP
+#define KERNEL_SEQLOCK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "cpu.hpp"
+#include "spinlock.hpp"
+
+namespace kernel {
+
+/**
+ * Sequence counter, odd while a write is in progress. Readers retry when
+ * the count changed under them, so they never write shared memory.
+ * Writers must be serialised by the caller.
+ */
+class SeqCount {
+public:
+    constexpr SeqCount() noexcept :
+        seq(0)
+    {}
+
+    auto BeginRead() const noexcept -> std::uint32_t
+    {
+        auto start = seq.load(std::memory_order_acquire);
+        while (start & 1) {
+            CPURelax();
+            start = seq.load(std::memory_order_acquire);
+        }
+        return start;
+    }
+
+    /**
+     * True if the data read since BeginRead() may be torn.
+     */
+    bool Retry(std::uint32_t start) const noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq.load(std::memory_order_relaxed) != start;
+    }
+
+    void BeginWrite() noexcept
+    {
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void EndWrite() noexcept
+    {
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+private:
+    std::atomic<std::uint32_t> seq;
+};
+
+/**
+ * Small value read as a consistent snapshot without locking. Writers take
+ * a ticket lock with interrupts disabled, so a reader interrupting a
+ * writer on the same CPU can't spin forever. The value is kept in atomic
+ * words so torn reads are discarded rather than undefined.
+ */
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    static constexpr std::size_t Words = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+public:
+    constexpr SeqLock() noexcept :
+        words{}
+    {}
+
+    explicit SeqLock(const T& value) noexcept :
+        words{}
+    {
+        Store(value);
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    auto Read() const noexcept -> T
+    {
+        std::uint64_t buffer[Words];
+        std::uint32_t start;
+        do {
+            start = count.BeginRead();
+            for (std::size_t i = 0; i < Words; ++i) {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+        } while (count.Retry(start));
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    void Write(const T& value) noexcept
+    {
+        SpinLockGuard guard(lock);
+        count.BeginWrite();
+        Store(value);
+        count.EndWrite();
+    }
+
+    /**
+     * Calls fn on a copy of the value and publishes the result, atomically
+     * with respect to other writers.
+     */
+    template <typename Fn>
+    void Update(Fn&& fn)
+    {
+        SpinLockGuard guard(lock);
+        auto value = Load();
+        fn(value);
+        count.BeginWrite();
+        Store(value);
+        count.EndWrite();
+    }
+private:
+    auto Load() const noexcept -> T
+    {
+        std::uint64_t buffer[Words];
+        for (std::size_t i = 0; i < Words; ++i) {
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        }
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    void Store(const T& value) noexcept
+    {
+        std::uint64_t buffer[Words] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        for (std::size_t i = 0; i < Words; ++i) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+    }
+
+    SeqCount count;
+    TicketLock lock;
+    std::atomic<std::uint64_t> words[Words];
+};
+
+} // namespace kernel
+
+#endif // KERNEL_SEQLOCK_HPP
@@ -0,0 +1,122 @@
+#ifndef SLIST_H
+#define SLIST_H
+
+#include "node.hpp"
+#include "slist_node.hpp"
+#include <memory>
+
+namespace kernel::intrusive {
+
+template <typename T, typename CastPolicyGen = BaseClassCastPolicy<SListNode<>, T>>
+class SList;
+
+/**
+ * Singly linked LIFO list, a pointer per node instead of the two that a
+ * List node takes. Not thread safe.
+ */
+template <typename T, typename CastPolicyGen>
+class SList : detail::ContainerNodeRequirments<T, CastPolicyGen> {
+    using CastPolicy = CastPolicyGen;
+    using NodeType = typename CastPolicy::NodeType;
+public:
+    class Iterator : public detail::BasicIterator<Iterator, T> {
+        friend class SList;
+        Iterator(NodeType* ptr) noexcept : ptr(ptr) {}
+    public:
+        Iterator& operator++() noexcept
+        {
+            ptr = static_cast<NodeType*>(ptr->next);
+            return *this;
+        }
+
+        T* operator->() const noexcept
+        {
+            return CastPolicy::FromNode(ptr);
+        }
+
+        bool operator==(const Iterator& other) const noexcept
+        {
+            return this->ptr == other.ptr;
+        }
+    private:
+        NodeType* ptr;
+    };
+
+    constexpr SList() noexcept :
+        head(nullptr)
+    {}
+
+    SList(SList&& oth) noexcept :
+        head(oth.head)
+    {
+        oth.head = nullptr;
+    }
+
+    SList& operator=(SList&& oth) noexcept
+    {
+        head = oth.head;
+        oth.head = nullptr;
+        return *this;
+    }
+
+    void PushFront(T& ref) noexcept
+    {
+        NodeType* elem = CastPolicy::ToNode(std::addressof(ref));
+        elem->next = head;
+        head = elem;
+    }
+
+    /**
+     * Unlinks and returns the first item, nullptr if the list is empty.
+     */
+    auto PopFront() noexcept -> T*
+    {
+        if (head == nullptr) {
+            return nullptr;
+        }
+        auto elem = head;
+        head = static_cast<NodeType*>(elem->next);
+        return CastPolicy::FromNode(elem);
+    }
+
+    auto Front() noexcept -> T&
+    {
+        return *CastPolicy::FromNode(head);
+    }
+
+    Iterator Begin() noexcept
+    {
+        return { head };
+    }
+
+    Iterator End() noexcept
+    {
+        return { nullptr };
+    }
+
+    friend Iterator begin(SList& list) noexcept
+    {
+        return list.Begin();
+    }
+
+    friend Iterator end(SList& list) noexcept
+    {
+        return list.End();
+    }
+
+    bool Empty() const noexcept
+    {
+        return head == nullptr;
+    }
+
+    constexpr void Clear() noexcept
+    {
+        head = nullptr;
+    }
+private:
+    NodeType* head;
+};
+
+}
+
+#endif // SLIST_H
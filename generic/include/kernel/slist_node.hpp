@@ -0,0 +1,36 @@
+#ifndef SLIST_NODE_H
+#define SLIST_NODE_H
+
+#include <atomic>
+
+namespace kernel::intrusive {
+
+template <typename Tag = void>
+struct SListNode;
+
+template <>
+struct SListNode<void> {
+    SListNode* next;
+};
+
+template <typename Tag>
+struct SListNode : SListNode<> {};
+
+/**
+ * Link of the lock-free containers. The link is read by other CPUs while
+ * the node may be changing hands, so it is atomic.
+ */
+template <typename Tag = void>
+struct AtomicSListNode;
+
+template <>
+struct AtomicSListNode<void> {
+    std::atomic<AtomicSListNode*> next;
+};
+
+template <typename Tag>
+struct AtomicSListNode : AtomicSListNode<> {};
+
+}
+
+#endif // SLIST_NODE_H
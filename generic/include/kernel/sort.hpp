@@ -0,0 +1,301 @@
+#ifndef KERNEL_SORT_HPP
+#define KERNEL_SORT_HPP
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+namespace kernel {
+
+namespace sort_detail {
+
+constexpr std::ptrdiff_t InsertionSortThreshold = 16;
+constexpr std::ptrdiff_t NintherThreshold = 128;
+
+template <typename It>
+void IterSwap(It a, It b)
+{
+    using std::swap;
+    swap(*a, *b);
+}
+
+template <typename It, typename Comp>
+auto Median3(It a, It b, It c, Comp& comp) -> It
+{
+    if (comp(*a, *b)) {
+        if (comp(*b, *c)) {
+            return b;
+        }
+        return comp(*a, *c) ? c : a;
+    }
+    if (comp(*a, *c)) {
+        return a;
+    }
+    return comp(*b, *c) ? c : b;
+}
+
+template <typename It, typename Comp>
+auto ChoosePivot(It first, std::ptrdiff_t count, Comp& comp) -> It
+{
+    It lo = first;
+    It mid = first + count / 2;
+    It hi = first + (count - 1);
+    if (count >= NintherThreshold) {
+        auto step = count / 8;
+        lo = Median3(lo, lo + step, lo + 2 * step, comp);
+        mid = Median3(mid - step, mid, mid + step, comp);
+        hi = Median3(hi - 2 * step, hi - step, hi, comp);
+    }
+    return Median3(lo, mid, hi, comp);
+}
+
+template <typename It, typename Comp>
+void InsertionSort(It first, It last, Comp& comp)
+{
+    if (first == last) {
+        return;
+    }
+    for (It i = first + 1; i != last; ++i) {
+        auto value = std::move(*i);
+        It hole = i;
+        for (It prev = i; hole != first && comp(value, *--prev); --hole) {
+            *hole = std::move(*prev);
+        }
+        *hole = std::move(value);
+    }
+}
+
+template <typename It, typename Comp>
+void SiftDown(It first, std::ptrdiff_t root, std::ptrdiff_t count, Comp& comp)
+{
+    auto value = std::move(first[root]);
+    std::ptrdiff_t child;
+    while ((child = 2 * root + 1) < count) {
+        if (child + 1 < count && comp(first[child], first[child + 1])) {
+            child += 1;
+        }
+        if (!comp(value, first[child])) {
+            break;
+        }
+        first[root] = std::move(first[child]);
+        root = child;
+    }
+    first[root] = std::move(value);
+}
+
+template <typename It, typename Comp>
+void HeapSort(It first, std::ptrdiff_t count, Comp& comp)
+{
+    for (auto i = count / 2; i > 0;) {
+        SiftDown(first, --i, count, comp);
+    }
+    for (auto end = count - 1; end > 0; --end) {
+        IterSwap(first, first + end);
+        SiftDown(first, 0, end, comp);
+    }
+}
+
+// Hoare partition around *first, returns the final position of the pivot
+template <typename It, typename Comp>
+auto Partition(It first, std::ptrdiff_t count, Comp& comp) -> std::ptrdiff_t
+{
+    std::ptrdiff_t i = 1;
+    std::ptrdiff_t j = count - 1;
+    while (true) {
+        while (i <= j && comp(first[i], *first)) {
+            ++i;
+        }
+        while (i <= j && comp(*first, first[j])) {
+            --j;
+        }
+        if (i >= j) {
+            break;
+        }
+        IterSwap(first + i, first + j);
+        ++i;
+        --j;
+    }
+    if (j != 0) {
+        IterSwap(first, first + j);
+    }
+    return j;
+}
+
+template <typename It, typename Comp>
+void IntroSort(It first, std::ptrdiff_t count, Comp& comp, int depth)
+{
+    while (count > InsertionSortThreshold) {
+        if (depth-- == 0) {
+            HeapSort(first, count, comp);
+            return;
+        }
+        auto pivot = ChoosePivot(first, count, comp);
+        if (pivot != first) {
+            IterSwap(first, pivot);
+        }
+        auto p = Partition(first, count, comp);
+        auto rightCount = count - p - 1;
+        if (p < rightCount) {
+            IntroSort(first, p, comp, depth);
+            first += p + 1;
+            count = rightCount;
+        } else {
+            IntroSort(first + (p + 1), rightCount, comp, depth);
+            count = p;
+        }
+    }
+    InsertionSort(first, first + count, comp);
+}
+
+template <typename It>
+void Reverse(It first, It last)
+{
+    while (first != last && first != --last) {
+        IterSwap(first++, last);
+    }
+}
+
+template <typename It>
+void Rotate(It first, It middle, It last)
+{
+    Reverse(first, middle);
+    Reverse(middle, last);
+    Reverse(first, last);
+}
+
+template <typename It, typename T, typename Comp>
+auto LowerBound(It first, It last, const T& value, Comp& comp) -> It
+{
+    auto count = last - first;
+    while (count > 0) {
+        auto half = count / 2;
+        if (comp(first[half], value)) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first;
+}
+
+template <typename It, typename T, typename Comp>
+auto UpperBound(It first, It last, const T& value, Comp& comp) -> It
+{
+    auto count = last - first;
+    while (count > 0) {
+        auto half = count / 2;
+        if (!comp(value, first[half])) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first;
+}
+
+// In-place stable merge of [first, middle) and [middle, last) by rotations,
+// O(n log n) moves, no scratch memory
+template <typename It, typename Comp>
+void MergeInPlace(It first, It middle, It last, Comp& comp)
+{
+    auto len1 = middle - first;
+    auto len2 = last - middle;
+    while (len1 != 0 && len2 != 0) {
+        if (len1 + len2 == 2) {
+            if (comp(*middle, *first)) {
+                IterSwap(first, middle);
+            }
+            return;
+        }
+        It cut1, cut2;
+        std::ptrdiff_t half1, half2;
+        if (len1 > len2) {
+            half1 = len1 / 2;
+            cut1 = first + half1;
+            cut2 = LowerBound(middle, last, *cut1, comp);
+            half2 = cut2 - middle;
+        } else {
+            half2 = len2 / 2;
+            cut2 = middle + half2;
+            cut1 = UpperBound(first, middle, *cut2, comp);
+            half1 = cut1 - first;
+        }
+        Rotate(cut1, middle, cut2);
+        It newMiddle = cut1 + half2;
+        // recurse into the smaller side, loop on the larger one
+        if (half1 + half2 < (len1 - half1) + (len2 - half2)) {
+            MergeInPlace(first, cut1, newMiddle, comp);
+            first = newMiddle;
+            middle = cut2;
+            len1 -= half1;
+            len2 -= half2;
+        } else {
+            MergeInPlace(newMiddle, cut2, last, comp);
+            last = newMiddle;
+            middle = cut1;
+            len1 = half1;
+            len2 = half2;
+        }
+    }
+}
+
+template <typename It, typename Comp>
+void StableSort(It first, std::ptrdiff_t count, Comp& comp)
+{
+    if (count <= InsertionSortThreshold) {
+        InsertionSort(first, first + count, comp);
+        return;
+    }
+    auto half = count / 2;
+    StableSort(first, half, comp);
+    StableSort(first + half, count - half, comp);
+    if (comp(first[half], first[half - 1])) {
+        MergeInPlace(first, first + half, first + count, comp);
+    }
+}
+
+inline int DepthLimit(std::ptrdiff_t count)
+{
+    int depth = 0;
+    for (; count > 1; count >>= 1) {
+        depth += 2;
+    }
+    return depth;
+}
+
+} // namespace sort_detail
+
+/**
+ * Introsort over a random access range. The comparator is a template
+ * parameter so each call site gets its own instantiation with the
+ * comparison inlined, unlike qsort.
+ */
+template <std::random_access_iterator It, typename Comp = std::less<>>
+void sort(It first, It last, Comp comp = {})
+{
+    auto count = std::ptrdiff_t(last - first);
+    if (count <= 1) {
+        return;
+    }
+    sort_detail::IntroSort(first, count, comp, sort_detail::DepthLimit(count));
+}
+
+/**
+ * Stable merge sort that merges in place, so it never allocates.
+ */
+template <std::random_access_iterator It, typename Comp = std::less<>>
+void stable_sort(It first, It last, Comp comp = {})
+{
+    auto count = std::ptrdiff_t(last - first);
+    if (count <= 1) {
+        return;
+    }
+    sort_detail::StableSort(first, count, comp);
+}
+
+} // namespace kernel
+
+#endif // KERNEL_SORT_HPP
@@ -0,0 +1,254 @@
+#ifndef KERNEL_SPINLOCK_HPP
+#define KERNEL_SPINLOCK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include "cpu.hpp"
+#include "interrupts.hpp"
+#ifdef KERNEL_LOCK_STATS
+#include "time.hpp"
+#endif
+
+namespace kernel {
+
+#ifdef KERNEL_LOCK_STATS
+/**
+ * Contention counters of one lock, updated by the lock holder. A lock
+ * joins the list printed by DumpLockStats() on its first acquisition.
+ */
+struct LockStats {
+    constexpr explicit LockStats(const char* name) noexcept :
+        name(name),
+        next(nullptr),
+        registered(false),
+        acquired(0),
+        contended(0),
+        waitCycles(0),
+        maxWait(0),
+        holdCycles(0),
+        maxHold(0),
+        heldSince(0)
+    {}
+
+    static auto Start() noexcept -> std::uint64_t
+    {
+        return Cycles();
+    }
+
+    void Acquired(std::uint64_t waitStart, bool wasContended) noexcept
+    {
+        auto now = Cycles();
+        if (!registered) {
+            Register();
+        }
+        ++acquired;
+        if (wasContended) {
+            ++contended;
+            auto wait = now - waitStart;
+            waitCycles += wait;
+            maxWait = wait > maxWait ? wait : maxWait;
+        }
+        heldSince = now;
+    }
+
+    void Released() noexcept
+    {
+        auto hold = Cycles() - heldSince;
+        holdCycles += hold;
+        maxHold = hold > maxHold ? hold : maxHold;
+    }
+
+    void Register() noexcept;
+
+    const char* name;
+    LockStats* next;
+    bool registered;
+    std::uint64_t acquired;
+    std::uint64_t contended;
+    std::uint64_t waitCycles;
+    std::uint64_t maxWait;
+    std::uint64_t holdCycles;
+    std::uint64_t maxHold;
+    std::uint64_t heldSince;
+};
+
+/**
+ * Prints acquisitions, contended acquisitions and average and maximum wait
+ * and hold times of every lock taken so far to the debug port. Counters
+ * are read without the locks, so a line may mix two updates.
+ */
+void DumpLockStats() noexcept;
+#else
+struct LockStats {
+    constexpr explicit LockStats(const char*) noexcept {}
+
+    static auto Start() noexcept -> std::uint64_t
+    {
+        return 0;
+    }
+
+    void Acquired(std::uint64_t, bool) noexcept {}
+    void Released() noexcept {}
+};
+#endif
+
+/**
+ * FIFO ticket lock for short critical sections. Waiters back off in
+ * proportion to their distance from the head of the queue. Doesn't touch
+ * the interrupt flag, see SpinLockGuard.
+ */
+class TicketLock {
+public:
+    // Lets TicketLock and MCSLock share SpinLockGuard
+    struct Node {};
+
+    constexpr explicit TicketLock(const char* name = nullptr) noexcept :
+        next(0),
+        serving(0),
+        stats(name)
+    {}
+
+    TicketLock(const TicketLock&) = delete;
+    TicketLock& operator=(const TicketLock&) = delete;
+
+    void Lock() noexcept
+    {
+        auto start = LockStats::Start();
+        auto ticket = next.fetch_add(1, std::memory_order_relaxed);
+        auto current = serving.load(std::memory_order_acquire);
+        bool wasContended = current != ticket;
+        while (current != ticket) {
+            for (auto i = (ticket - current) * BackoffPerWaiter; i != 0; --i) {
+                CPURelax();
+            }
+            current = serving.load(std::memory_order_acquire);
+        }
+        stats.Acquired(start, wasContended);
+    }
+
+    bool TryLock() noexcept
+    {
+        auto current = serving.load(std::memory_order_relaxed);
+        auto expected = current;
+        if (!next.compare_exchange_strong(expected, current + 1,
+            std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            return false;
+        }
+        stats.Acquired(0, false);
+        return true;
+    }
+
+    void Unlock() noexcept
+    {
+        stats.Released();
+        serving.store(serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void Lock(Node&) noexcept
+    {
+        Lock();
+    }
+
+    void Unlock(Node&) noexcept
+    {
+        Unlock();
+    }
+private:
+    static constexpr std::uint32_t BackoffPerWaiter = 32;
+
+    std::atomic<std::uint32_t> next;
+    std::atomic<std::uint32_t> serving;
+    [[no_unique_address]] LockStats stats;
+};
+
+/**
+ * Mellor-Crummey and Scott queue lock for contended sections: each waiter
+ * spins on its own Node, so a handover touches one remote cache line. The
+ * Node must stay in place until Unlock(). Doesn't touch the interrupt
+ * flag, see SpinLockGuard.
+ */
+class MCSLock {
+public:
+    struct Node {
+        std::atomic<Node*> next;
+        std::atomic<bool> locked;
+    };
+
+    constexpr explicit MCSLock(const char* name = nullptr) noexcept :
+        tail(nullptr),
+        stats(name)
+    {}
+
+    MCSLock(const MCSLock&) = delete;
+    MCSLock& operator=(const MCSLock&) = delete;
+
+    void Lock(Node& node) noexcept
+    {
+        auto start = LockStats::Start();
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.locked.store(true, std::memory_order_relaxed);
+        auto prev = tail.exchange(&node, std::memory_order_acq_rel);
+        if (prev != nullptr) {
+            prev->next.store(&node, std::memory_order_release);
+            while (node.locked.load(std::memory_order_acquire)) {
+                CPURelax();
+            }
+        }
+        stats.Acquired(start, prev != nullptr);
+    }
+
+    void Unlock(Node& node) noexcept
+    {
+        stats.Released();
+        auto next = node.next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            auto expected = &node;
+            if (tail.compare_exchange_strong(expected, nullptr,
+                std::memory_order_release, std::memory_order_relaxed))
+            {
+                return;
+            }
+            // A waiter swapped itself in but hasn't linked up yet
+            while ((next = node.next.load(std::memory_order_acquire)) == nullptr) {
+                CPURelax();
+            }
+        }
+        next->locked.store(false, std::memory_order_release);
+    }
+private:
+    std::atomic<Node*> tail;
+    [[no_unique_address]] LockStats stats;
+};
+
+/**
+ * Disables interrupts on the current CPU and holds lock for its lifetime,
+ * so the section is safe against interrupt handlers taking the same lock.
+ */
+template <class Lock>
+class SpinLockGuard {
+public:
+    explicit SpinLockGuard(Lock& lock) noexcept :
+        lock(lock),
+        state(SaveAndDisableInterrupts())
+    {
+        lock.Lock(node);
+    }
+
+    SpinLockGuard(const SpinLockGuard&) = delete;
+    SpinLockGuard& operator=(const SpinLockGuard&) = delete;
+
+    ~SpinLockGuard()
+    {
+        lock.Unlock(node);
+        RestoreInterrupts(state);
+    }
+private:
+    Lock& lock;
+    typename Lock::Node node;
+    InterruptState state;
+};
+
+} // namespace kernel
+
+#endif // KERNEL_SPINLOCK_HPP
@@ -0,0 +1,221 @@
+#ifndef KERNEL_SPSC_RING_HPP
+#define KERNEL_SPSC_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include "cpu.hpp"
+#include "util.hpp"
+
+namespace kernel {
+
+/**
+ * Bounded single-producer single-consumer ring of Capacity elements,
+ * Capacity a power of two. Both sides work in place on contiguous spans:
+ * the producer fills what Reserve() returns and publishes it with Commit(),
+ * the consumer reads what Peek() returns and frees it with Release(). The
+ * producer may run in an interrupt handler, every operation is O(1) and
+ * never waits. Each side keeps its index and a cached copy of the other
+ * side's index on its own cache line.
+ */
+template <typename T, std::size_t Capacity>
+class SPSCRing {
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0);
+
+    static constexpr std::size_t Mask = Capacity - 1;
+public:
+    constexpr SPSCRing() noexcept :
+        producer{},
+        consumer{},
+        slots{}
+    {}
+
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    /**
+     * Free slots for up to n elements, shorter at the wrap point or when
+     * the ring is fuller than that; empty when the ring is full. Producer
+     * only.
+     */
+    auto Reserve(std::size_t n) noexcept -> std::span<T>
+    {
+        auto head = producer.head.load(std::memory_order_relaxed);
+        auto free = Capacity - (head - producer.tailCache);
+        if (free < n) {
+            producer.tailCache = consumer.tail.load(std::memory_order_acquire);
+            free = Capacity - (head - producer.tailCache);
+        }
+        auto offset = head & Mask;
+        return { slots + offset, std::min({ n, free, Capacity - offset }) };
+    }
+
+    /**
+     * Publishes the first n elements of the last Reserve() span.
+     */
+    void Commit(std::size_t n) noexcept
+    {
+        auto head = producer.head.load(std::memory_order_relaxed);
+        producer.head.store(head + n, std::memory_order_release);
+    }
+
+    /**
+     * Up to n published elements, shorter at the wrap point; empty when
+     * the ring is empty. Consumer only.
+     */
+    auto Peek(std::size_t n) noexcept -> std::span<T>
+    {
+        auto tail = consumer.tail.load(std::memory_order_relaxed);
+        auto used = consumer.headCache - tail;
+        if (used < n) {
+            consumer.headCache = producer.head.load(std::memory_order_acquire);
+            used = consumer.headCache - tail;
+        }
+        auto offset = tail & Mask;
+        return { slots + offset, std::min({ n, used, Capacity - offset }) };
+    }
+
+    /**
+     * Frees the first n elements of the last Peek() span.
+     */
+    void Release(std::size_t n) noexcept
+    {
+        auto tail = consumer.tail.load(std::memory_order_relaxed);
+        consumer.tail.store(tail + n, std::memory_order_release);
+    }
+
+    bool Push(const T& value) noexcept
+    {
+        auto span = Reserve(1);
+        if (span.empty()) {
+            return false;
+        }
+        span[0] = value;
+        Commit(1);
+        return true;
+    }
+
+    /**
+     * Copies all of values in, across the wrap point if needed, and
+     * publishes them at once; copies nothing if they don't fit.
+     */
+    bool PushAll(std::span<const T> values) noexcept
+    {
+        auto head = producer.head.load(std::memory_order_relaxed);
+        if (Capacity - (head - producer.tailCache) < values.size()) {
+            producer.tailCache = consumer.tail.load(std::memory_order_acquire);
+            if (Capacity - (head - producer.tailCache) < values.size()) {
+                return false;
+            }
+        }
+        auto offset = head & Mask;
+        auto first = std::min(values.size(), Capacity - offset);
+        std::copy_n(values.data(), first, slots + offset);
+        std::copy_n(values.data() + first, values.size() - first, slots);
+        producer.head.store(head + values.size(), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Copies the next out.size() elements out, across the wrap point if
+     * needed, and frees them at once; copies nothing if fewer are
+     * published.
+     */
+    bool PopAll(std::span<T> out) noexcept
+    {
+        auto tail = consumer.tail.load(std::memory_order_relaxed);
+        if (consumer.headCache - tail < out.size()) {
+            consumer.headCache = producer.head.load(std::memory_order_acquire);
+            if (consumer.headCache - tail < out.size()) {
+                return false;
+            }
+        }
+        auto offset = tail & Mask;
+        auto first = std::min(out.size(), Capacity - offset);
+        std::copy_n(slots + offset, first, out.data());
+        std::copy_n(slots, out.size() - first, out.data() + first);
+        consumer.tail.store(tail + out.size(), std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& value) noexcept
+    {
+        auto span = Peek(1);
+        if (span.empty()) {
+            return false;
+        }
+        value = span[0];
+        Release(1);
+        return true;
+    }
+private:
+    struct alignas(64) ProducerSide {
+        std::atomic<std::size_t> head;
+        std::size_t tailCache;
+    };
+
+    struct alignas(64) ConsumerSide {
+        std::atomic<std::size_t> tail;
+        std::size_t headCache;
+    };
+
+    ProducerSide producer;
+    ConsumerSide consumer;
+    T slots[Capacity];
+};
+
+/**
+ * One Ring per CPU, allocated for the CPUs online at the time and never
+ * freed. Get() may run anywhere, including in the handler that fills the
+ * ring; Allocate() and Count() need a lock of the caller.
+ */
+template <typename Ring>
+class PerCPURings {
+public:
+    constexpr PerCPURings() noexcept = default;
+
+    PerCPURings(const PerCPURings&) = delete;
+    PerCPURings& operator=(const PerCPURings&) = delete;
+
+    /**
+     * Allocates the rings still missing; false if out of memory.
+     */
+    bool Allocate() noexcept
+    {
+        for (auto cpus = CPUCount(); count < cpus; ++count) {
+            // malloc() doesn't promise the cache line alignment of a ring.
+            // Nothing is freed, so the slack needs no bookkeeping.
+            auto storage = std::malloc(sizeof(Ring) + alignof(Ring) - 1);
+            if (storage == nullptr) {
+                return false;
+            }
+            auto address = (ptr_cast(storage) + alignof(Ring) - 1) & ~(alignof(Ring) - 1);
+            rings[count].store(new (ptr_cast<void*>(address)) Ring, std::memory_order_release);
+        }
+        return true;
+    }
+
+    /**
+     * Ring of cpu, or null before it is allocated.
+     */
+    auto Get(unsigned cpu) const noexcept -> Ring*
+    {
+        return rings[cpu].load(std::memory_order_acquire);
+    }
+
+    auto Count() const noexcept -> unsigned
+    {
+        return count;
+    }
+private:
+    std::atomic<Ring*> rings[MaxCPUs] = {};
+    unsigned count = 0;
+};
+
+} // namespace kernel
+
+#endif // KERNEL_SPSC_RING_HPP
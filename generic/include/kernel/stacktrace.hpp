@@ -0,0 +1,26 @@
+#ifndef KERNEL_STACKTRACE_HPP
+#define KERNEL_STACKTRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace kernel {
+
+/**
+ * Fills out with return addresses found by following saved frame pointers,
+ * innermost first, starting with the call to CaptureStackTrace itself.
+ * Returns how many were stored. The walk stops at a null frame or one that
+ * doesn't lie above the previous one on the same stack, so it is only
+ * complete when everything on the path keeps frame pointers.
+ */
+auto CaptureStackTrace(std::span<std::uintptr_t> out) noexcept -> std::size_t;
+
+/**
+ * Same walk starting from the frame pointer of an interrupted context.
+ */
+auto CaptureStackTrace(std::span<std::uintptr_t> out, std::uintptr_t framePointer) noexcept -> std::size_t;
+
+} // namespace kernel
+
+#endif // KERNEL_STACKTRACE_HPP
@@ -0,0 +1,24 @@
+#ifndef KERNEL_SYMBOLS_HPP
+#define KERNEL_SYMBOLS_HPP
+
+#include <cstdint>
+#include <string_view>
+
+namespace kernel {
+
+struct SymbolInfo {
+    // Mangled; empty when the address isn't covered by the table
+    std::string_view name;
+    std::uintptr_t offset;
+};
+
+/**
+ * Finds the function containing address in the symbol table embedded at
+ * link time. The table is only generated for KERNEL_PROFILER builds, every
+ * lookup comes back empty in others.
+ */
+auto LookupSymbol(std::uintptr_t address) noexcept -> SymbolInfo;
+
+} // namespace kernel
+
+#endif // KERNEL_SYMBOLS_HPP
@@ -0,0 +1,121 @@
+#ifndef KERNEL_THREAD_HPP
+#define KERNEL_THREAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "list.hpp"
+
+namespace kernel {
+
+namespace thread_detail {
+
+struct Scheduler;
+
+} // namespace thread_detail
+
+/**
+ * Kernel thread. The Thread object lives at the top of the thread's own
+ * stack and is released together with it when the thread function returns
+ * or calls ExitThread(), so it must not be referenced after that.
+ */
+class Thread : public intrusive::ListNode<> {
+public:
+    using Function = void (*)(void* arg);
+
+    static constexpr std::size_t DefaultStackSize = 0x4000;
+
+    enum State : std::uint8_t {
+        State_Ready,
+        State_Running,
+        State_Blocked,
+        State_Finished,
+    };
+
+    Thread(const Thread&) = delete;
+    Thread& operator=(const Thread&) = delete;
+
+    /**
+     * Starts fn(arg) on a new stack of stackSize bytes. Returns nullptr if
+     * the stack can't be allocated.
+     */
+    static auto Create(Function fn, void* arg, std::size_t stackSize = DefaultStackSize) noexcept
+        -> Thread*;
+    static auto Current() noexcept -> Thread&;
+
+    /**
+     * Makes a blocked thread ready. Waking a thread that isn't blocked makes
+     * its next Block() return immediately. Safe from interrupt handlers.
+     */
+    void Wake() noexcept;
+
+    auto GetState() const noexcept -> State
+    {
+        return state;
+    }
+private:
+    friend struct thread_detail::Scheduler;
+
+    constexpr Thread() noexcept :
+        ListNode{},
+        sp(nullptr),
+        stackTop(nullptr),
+        stackSize(0),
+        fn(nullptr),
+        arg(nullptr),
+        state(State_Ready),
+        wakePending(false)
+    {}
+
+    void* sp;
+    void* stackTop;
+    std::size_t stackSize;
+    Function fn;
+    void* arg;
+    State state;
+    bool wakePending;
+};
+
+/**
+ * Gives the CPU to the next ready thread, if there is one.
+ */
+void Yield() noexcept;
+
+/**
+ * Suspends the current thread until Thread::Wake() is called on it.
+ */
+void Block() noexcept;
+
+[[noreturn]] void ExitThread() noexcept;
+
+/**
+ * Turns the boot flow into the first thread and starts the idle thread.
+ * Called once by the platform once kernel timers work.
+ */
+void InitThreads() noexcept;
+
+/**
+ * Called by the platform with interrupts disabled right before returning
+ * from an outermost interrupt to thread context. Switches threads when the
+ * time slice is over or the idle thread has work waiting.
+ */
+void PreemptFromInterrupt() noexcept;
+
+/**
+ * Implemented by the platform: lays out an initial context on the stack
+ * below stackTop that starts start(arg) with interrupts disabled, and
+ * returns its stack pointer for SwitchThreadContext().
+ */
+auto InitThreadContext(void* stackTop, void (*start)(void* arg), void* arg) noexcept -> void*;
+
+/**
+ * Implemented by the platform: saves callee-saved state and the stack
+ * pointer to *save and resumes the context at load.
+ */
+void SwitchThreadContext(void** save, void* load) noexcept;
+
+auto AllocateThreadStack(std::size_t size) noexcept -> void*;
+void FreeThreadStack(void* top, std::size_t size) noexcept;
+
+} // namespace kernel
+
+#endif // KERNEL_THREAD_HPP
@@ -0,0 +1,72 @@
+#ifndef KERNEL_TIME_HPP
+#define KERNEL_TIME_HPP
+
+#include <cstdint>
+#include "util.hpp"
+
+namespace kernel {
+
+namespace time_detail {
+
+// Conversions are a 64x64->128 multiply by a 32.32 fixed point factor
+constexpr unsigned ScaleShift = 32;
+
+struct Clock {
+    std::uint64_t frequency;
+    std::uint64_t nsMult;
+    std::uint64_t cyclesMult;
+    std::uint64_t base;
+};
+
+extern Clock clock;
+
+inline auto Scale(std::uint64_t value, std::uint64_t mult) noexcept -> std::uint64_t
+{
+    return std::uint64_t((uint128_t(value) * mult) >> ScaleShift);
+}
+
+} // namespace time_detail
+
+constexpr std::uint64_t NsPerSecond = 1000000000;
+
+/**
+ * Raw cycle counter, monotonic and constant rate. Implemented by the
+ * platform.
+ */
+auto Cycles() noexcept -> std::uint64_t;
+
+/**
+ * Cycle counter frequency in Hz, 0 until the platform has calibrated it.
+ */
+inline auto CycleFrequency() noexcept -> std::uint64_t
+{
+    return time_detail::clock.frequency;
+}
+
+inline auto CyclesToNs(std::uint64_t cycles) noexcept -> std::uint64_t
+{
+    return time_detail::Scale(cycles, time_detail::clock.nsMult);
+}
+
+inline auto NsToCycles(std::uint64_t ns) noexcept -> std::uint64_t
+{
+    return time_detail::Scale(ns, time_detail::clock.cyclesMult);
+}
+
+/**
+ * Monotonic nanoseconds since the clock was calibrated.
+ */
+inline auto Now() noexcept -> std::uint64_t
+{
+    return CyclesToNs(Cycles() - time_detail::clock.base);
+}
+
+/**
+ * Called by the platform once the cycle counter frequency is known; Now()
+ * counts from this point.
+ */
+void InitClock(std::uint64_t frequency) noexcept;
+
+} // namespace kernel
+
+#endif // KERNEL_TIME_HPP
@@ -0,0 +1,95 @@
+#ifndef KERNEL_TIMER_HPP
+#define KERNEL_TIMER_HPP
+
+#include <cstdint>
+#include "list.hpp"
+#include "time.hpp"
+
+namespace kernel {
+
+namespace timer_detail {
+
+// 6 levels of 64 slots over 65.536 us ticks reach about 52 days ahead,
+// later deadlines are parked in the last level and re-filed on expiry
+constexpr unsigned TickShift = 16;
+constexpr unsigned LevelBits = 6;
+constexpr unsigned LevelSlots = 1 << LevelBits;
+constexpr unsigned Levels = 6;
+
+struct Wheel;
+
+} // namespace timer_detail
+
+/**
+ * One-shot timer on a hierarchical timing wheel. Arm and Cancel are O(1);
+ * callbacks run in deferred work context with interrupts enabled and never
+ * before their deadline, but may run up to one wheel tick late.
+ */
+class Timer : public intrusive::ListNode<> {
+public:
+    using Function = void (*)(void* ctx);
+
+    constexpr Timer(Function fn, void* ctx) noexcept :
+        ListNode{},
+        fn(fn),
+        ctx(ctx),
+        expires(0),
+        level(Idle),
+        slot(0)
+    {}
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    /**
+     * Fires the timer once Now() reaches deadline. Re-arming a pending timer
+     * moves it. Safe from any context and CPU except NMI; deadlines armed
+     * off the bootstrap processor reach its timer through deferred work.
+     */
+    void Arm(std::uint64_t deadline) noexcept;
+
+    void ArmAfter(std::uint64_t delay) noexcept
+    {
+        Arm(Now() + delay);
+    }
+
+    /**
+     * Returns true if the timer was pending. Doesn't wait for a callback
+     * that is already running.
+     */
+    bool Cancel() noexcept;
+
+    bool Pending() const noexcept
+    {
+        return level != Idle;
+    }
+private:
+    friend struct timer_detail::Wheel;
+
+    static constexpr std::uint8_t Idle = 0xFF;
+
+    Function fn;
+    void* ctx;
+    std::uint64_t expires;
+    std::uint8_t level;
+    std::uint8_t slot;
+};
+
+/**
+ * Called by the platform from its timer interrupt. Expiry processing is
+ * handed to deferred work, so spurious or early calls are harmless.
+ */
+void TimerInterrupt() noexcept;
+
+/**
+ * Implemented by the platform and only called on the bootstrap processor:
+ * call TimerInterrupt() once Cycles() reaches deadline, replacing any
+ * earlier request. Deadlines in the past fire immediately; the interrupt
+ * may arrive early if the hardware can't reach the deadline in one go.
+ */
+void SetTimerDeadline(std::uint64_t deadline) noexcept;
+void StopTimerDeadline() noexcept;
+
+} // namespace kernel
+
+#endif // KERNEL_TIMER_HPP
@@ -0,0 +1,159 @@
+#ifndef KERNEL_TRACE_HPP
+#define KERNEL_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include "jump_label.hpp"
+#include "time.hpp"
+
+namespace kernel {
+
+/**
+ * Field type printed in hex, for addresses
+ */
+enum class TraceHex : std::uint64_t {};
+
+enum class TraceFieldFormat : std::uint8_t {
+    Unsigned,
+    Signed,
+    Hex,
+};
+
+struct TraceField {
+    const char* name;
+    std::uint16_t offset;
+    std::uint8_t size;
+    TraceFieldFormat format;
+};
+
+/**
+ * Descriptor of an event declared by TRACE_EVENT(). All of them sit in the
+ * __trace_events section, so they must keep one size and alignment.
+ */
+struct alignas(64) TraceEvent {
+    StaticKey key;
+    std::uint16_t size;
+    std::uint16_t fieldCount;
+    const char* name;
+    const TraceField* fields;
+};
+
+namespace trace_detail {
+
+// Largest record payload, what a dump reads into at once
+constexpr std::size_t MaxPayload = 64;
+
+// Precedes every record in the rings
+struct Header {
+    std::uint64_t time;
+    const TraceEvent* event;
+};
+
+void Write(std::span<const unsigned char> record) noexcept;
+
+template <typename T>
+constexpr auto FieldFormat() -> TraceFieldFormat
+{
+    static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "trace fields are integers");
+    if constexpr (std::is_same_v<T, TraceHex>) {
+        return TraceFieldFormat::Hex;
+    } else if constexpr (std::is_signed_v<T>) {
+        return TraceFieldFormat::Signed;
+    } else {
+        return TraceFieldFormat::Unsigned;
+    }
+}
+
+template <typename Record>
+[[gnu::noinline]] void Emit(const TraceEvent& event, const Record& record) noexcept
+{
+    static_assert(std::is_trivially_copyable_v<Record>);
+    Header header{ Now(), &event };
+    unsigned char buf[sizeof(header) + sizeof(record)];
+    std::memcpy(buf, &header, sizeof(header));
+    std::memcpy(buf + sizeof(header), &record, sizeof(record));
+    Write(buf);
+}
+
+} // namespace trace_detail
+
+// Applies m(data, field) to each of up to 6 (type, name) fields
+#define KERNEL_TRACE_EACH_1(m, d, f) m(d, f)
+#define KERNEL_TRACE_EACH_2(m, d, f, ...) m(d, f) KERNEL_TRACE_EACH_1(m, d, __VA_ARGS__)
+#define KERNEL_TRACE_EACH_3(m, d, f, ...) m(d, f) KERNEL_TRACE_EACH_2(m, d, __VA_ARGS__)
+#define KERNEL_TRACE_EACH_4(m, d, f, ...) m(d, f) KERNEL_TRACE_EACH_3(m, d, __VA_ARGS__)
+#define KERNEL_TRACE_EACH_5(m, d, f, ...) m(d, f) KERNEL_TRACE_EACH_4(m, d, __VA_ARGS__)
+#define KERNEL_TRACE_EACH_6(m, d, f, ...) m(d, f) KERNEL_TRACE_EACH_5(m, d, __VA_ARGS__)
+#define KERNEL_TRACE_PICK(_1, _2, _3, _4, _5, _6, each, ...) each
+#define KERNEL_TRACE_EACH(m, d, ...) \
+    KERNEL_TRACE_PICK(__VA_ARGS__, KERNEL_TRACE_EACH_6, KERNEL_TRACE_EACH_5, \
+        KERNEL_TRACE_EACH_4, KERNEL_TRACE_EACH_3, KERNEL_TRACE_EACH_2, \
+        KERNEL_TRACE_EACH_1)(m, d, __VA_ARGS__)
+#define KERNEL_TRACE_STRIP(...) __VA_ARGS__
+#define KERNEL_TRACE_APPLY(m, args) m args
+#define KERNEL_TRACE_MEMBER_I(type, field) type field;
+#define KERNEL_TRACE_MEMBER(record, f) KERNEL_TRACE_MEMBER_I f
+#define KERNEL_TRACE_INFO_I(record, type, field) \
+    { #field, offsetof(record, field), sizeof(type), ::kernel::trace_detail::FieldFormat<type>() },
+#define KERNEL_TRACE_INFO(record, f) \
+    KERNEL_TRACE_APPLY(KERNEL_TRACE_INFO_I, (record, KERNEL_TRACE_STRIP f))
+
+/**
+ * Declares event name with up to 6 integer fields given as (type, name)
+ * pairs, e.g. TRACE_EVENT(BuddySplit, (std::uint8_t, order)). Its record
+ * is the fields packed as a struct behind a 16-byte header. Use once, in
+ * the anonymous namespace of the source file that emits it.
+ */
+#define TRACE_EVENT(name, ...) \
+    struct name##Record { \
+        KERNEL_TRACE_EACH(KERNEL_TRACE_MEMBER, name##Record, __VA_ARGS__) \
+    }; \
+    static_assert(sizeof(name##Record) <= ::kernel::trace_detail::MaxPayload, \
+        "fields of " #name " exceed the trace record payload"); \
+    constexpr ::kernel::TraceField name##Fields[] = { \
+        KERNEL_TRACE_EACH(KERNEL_TRACE_INFO, name##Record, __VA_ARGS__) \
+    }; \
+    [[gnu::section("__trace_events"), gnu::used]] constinit ::kernel::TraceEvent name{ \
+        {}, sizeof(name##Record), std::uint16_t(std::size(name##Fields)), #name, name##Fields \
+    }
+
+/**
+ * Records event name with the field values in declaration order into the
+ * current CPU's trace ring. Costs one NOP while the event is disabled.
+ */
+#define TRACE(name, ...) \
+    do { \
+        if (::kernel::StaticKeyEnabled(name.key)) [[unlikely]] { \
+            ::kernel::trace_detail::Emit(name, name##Record{ __VA_ARGS__ }); \
+        } \
+    } while (false)
+
+/**
+ * Enables or disables the events called name, or all of them for "*", and
+ * returns how many matched. The per-CPU rings are allocated the first time
+ * an event is enabled; returns 0 if that fails. Thread context only.
+ */
+auto SetTraceEvents(std::string_view name, bool enabled) noexcept -> unsigned;
+
+enum class TraceFormat {
+    // One "time cpu event field=value ..." line per record
+    Text,
+    // Chrome trace event JSON, for chrome://tracing or Perfetto
+    ChromeJSON,
+};
+
+/**
+ * Empties the trace rings into the log sink, CPU by CPU in recording order.
+ * Records that found their ring full are only counted. Returns at once if
+ * another dump is running.
+ */
+void DumpTrace(TraceFormat format) noexcept;
+
+} // namespace kernel
+
+#endif // KERNEL_TRACE_HPP
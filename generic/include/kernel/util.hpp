@@ -9,6 +9,9 @@
 
 namespace kernel {
 
+__extension__ typedef unsigned __int128 uint128_t;
+__extension__ typedef __int128 int128_t;
+
 template <class T>
 struct ReplaceByVoid {
     using Type = void;
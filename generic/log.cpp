@@ -0,0 +1,120 @@
+#include "kernel/log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include "kernel/cpu.hpp"
+#include "kernel/debug.h"
+#include "kernel/deferred_work.hpp"
+#include "kernel/interrupts.hpp"
+#include "kernel/spinlock.hpp"
+#include "kernel/spsc_ring.hpp"
+
+namespace kernel {
+
+namespace log_detail {
+
+constexpr std::size_t RingSize = 2048;
+
+using Ring = SPSCRing<char, RingSize>;
+
+namespace {
+
+void DefaultSink(std::string_view text)
+{
+    debug::puts(text);
+}
+
+void FlushWork(void*, std::uint32_t)
+{
+    FlushLog();
+}
+
+// Each ring is filled by its CPU with interrupts disabled and emptied by
+// whoever holds flushLock. That is only taken with interrupts disabled, so
+// a holder is never preempted and nobody waits on it for long.
+constinit Ring rings[MaxCPUs];
+constinit TicketLock flushLock{ "log" };
+constinit std::atomic<LogSink> sink = DefaultSink;
+constinit std::atomic<std::uint64_t> dropped;
+constinit DeferredWork flushWork{ FlushWork, nullptr };
+
+// Caller holds flushLock
+void Drain(LogSink out)
+{
+    auto count = CPUCount();
+    for (unsigned cpu = 0; cpu < count; ++cpu) {
+        auto& ring = rings[cpu];
+        for (auto span = ring.Peek(RingSize); !span.empty(); span = ring.Peek(RingSize)) {
+            out({ span.data(), span.size() });
+            ring.Release(span.size());
+        }
+    }
+    if (auto lost = dropped.exchange(0, std::memory_order_relaxed); lost != 0) {
+        char buf[48];
+        auto size = format_to(buf, "[Log] {} line(s) dropped\n", lost);
+        out({ buf, size });
+    }
+}
+
+} // namespace
+
+void Write(std::string_view line) noexcept
+{
+    bool written;
+    {
+        InterruptGuard guard;
+        written = rings[this_cpu().index].PushAll(line);
+    }
+    if (!written) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!flushWork.Pending()) {
+        flushWork.Schedule();
+    }
+}
+
+} // namespace log_detail
+
+void SetLogSink(LogSink sink) noexcept
+{
+    log_detail::sink.store(sink, std::memory_order_release);
+}
+
+void FlushLog() noexcept
+{
+    using namespace log_detail;
+    InterruptGuard guard;
+    if (!flushLock.TryLock()) {
+        return;
+    }
+    Drain(sink.load(std::memory_order_acquire));
+    flushLock.Unlock();
+}
+
+void WriteLog(std::string_view text) noexcept
+{
+    using namespace log_detail;
+    // Half a ring at a time, so a piece fits once the ring is drained
+    constexpr std::size_t pieceSize = RingSize / 2;
+    while (!text.empty()) {
+        std::string_view piece(text.data(), std::min(text.size(), pieceSize));
+        bool written;
+        {
+            InterruptGuard guard;
+            written = rings[this_cpu().index].PushAll(piece);
+        }
+        if (written) {
+            text.remove_prefix(piece.size());
+        } else {
+            // Either this drains the ring or another CPU is doing so
+            FlushLog();
+            CPURelax();
+        }
+    }
+    FlushLog();
+    if (!flushWork.Pending()) {
+        flushWork.Schedule();
+    }
+}
+
+} // namespace kernel
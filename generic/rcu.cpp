@@ -0,0 +1,156 @@
+#include "kernel/rcu.hpp"
+#include <cstdint>
+#include "kernel/cpu.hpp"
+#include "kernel/deferred_work.hpp"
+#include "kernel/executor.hpp"
+#include "kernel/slist.hpp"
+#include "kernel/spinlock.hpp"
+#include "kernel/thread.hpp"
+#include "kernel/timer.hpp"
+
+namespace kernel {
+
+namespace rcu_detail {
+
+constexpr std::uint64_t PollNs = 1000000;
+
+struct alignas(64) CPUState {
+    // Newest grace period this CPU has seen at a quiescent point
+    std::atomic<std::uint64_t> seen;
+};
+
+using Batch = intrusive::SList<RCUHead>;
+
+// Callbacks move from next to waiting when a grace period is requested for
+// them, one batch in flight at a time. Completion is polled from a timer
+// that also interrupts the other CPUs so halted ones report.
+struct Domain {
+    std::atomic<std::uint64_t> gp;
+    CPUState cpus[MaxCPUs];
+    TicketLock lock{ "rcu" };
+    Batch next;
+    Batch waiting;
+    std::uint64_t target = 0;
+    bool armed = false;
+    Timer poll{ Poll, nullptr };
+    DeferredWork kick{ Kick, nullptr };
+
+    bool Completed() noexcept
+    {
+        auto count = CPUCount();
+        for (unsigned i = 0; i < count; ++i) {
+            if (cpus[i].seen.load(std::memory_order_acquire) < target) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void StartBatch() noexcept
+    {
+        if (!waiting.Empty() || next.Empty()) {
+            return;
+        }
+        waiting = std::move(next);
+        target = gp.fetch_add(1, std::memory_order_seq_cst) + 1;
+    }
+
+    void ArmPoll() noexcept;
+    static void Poll(void*);
+    static void Kick(void*, std::uint32_t);
+};
+
+namespace {
+
+constinit Domain domain;
+
+} // namespace
+
+// Timers live on the bootstrap processor, other CPUs get there through
+// deferred work and a wakeup interrupt
+void Domain::ArmPoll() noexcept
+{
+    InterruptGuard guard;
+    if (this_cpu().index == 0) {
+        poll.ArmAfter(PollNs);
+    } else {
+        kick.Schedule();
+        WakeIdleCPUs();
+    }
+}
+
+void Domain::Poll(void*)
+{
+    // Timer callbacks never run inside a read-side section
+    RCUQuiescentState();
+    Batch ready;
+    bool more;
+    {
+        SpinLockGuard guard(domain.lock);
+        if (!domain.waiting.Empty() && domain.Completed()) {
+            ready = std::move(domain.waiting);
+        }
+        domain.StartBatch();
+        more = !domain.waiting.Empty();
+        domain.armed = more;
+    }
+    while (auto head = ready.PopFront()) {
+        head->fn(head);
+    }
+    if (more) {
+        WakeIdleCPUs();
+        domain.poll.ArmAfter(PollNs);
+    }
+}
+
+void Domain::Kick(void*, std::uint32_t)
+{
+    domain.poll.ArmAfter(PollNs);
+}
+
+} // namespace rcu_detail
+
+void RCURetire(RCUHead& head, RCUHead::Function fn) noexcept
+{
+    using rcu_detail::domain;
+    head.fn = fn;
+    bool arm;
+    {
+        SpinLockGuard guard(domain.lock);
+        domain.next.PushFront(head);
+        domain.StartBatch();
+        arm = !domain.armed;
+        domain.armed = true;
+    }
+    if (arm) {
+        domain.ArmPoll();
+    }
+}
+
+void RCUSynchronize() noexcept
+{
+    struct Waiter : RCUHead {
+        Thread* thread;
+        std::atomic<bool> done;
+    } waiter;
+    waiter.thread = &Thread::Current();
+    waiter.done.store(false, std::memory_order_relaxed);
+    RCURetire(waiter, [](RCUHead* head) {
+        auto& waiter = static_cast<Waiter&>(*head);
+        auto thread = waiter.thread;
+        waiter.done.store(true, std::memory_order_release);
+        thread->Wake();
+    });
+    while (!waiter.done.load(std::memory_order_acquire)) {
+        Block();
+    }
+}
+
+void RCUQuiescentState() noexcept
+{
+    using rcu_detail::domain;
+    auto& state = domain.cpus[this_cpu().index];
+    state.seen.store(domain.gp.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+} // namespace kernel
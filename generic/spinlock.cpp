@@ -0,0 +1,44 @@
+#include "kernel/spinlock.hpp"
+
+#ifdef KERNEL_LOCK_STATS
+#include "kernel/debug.h"
+#include "kernel/format.hpp"
+
+namespace kernel {
+
+namespace {
+
+constinit std::atomic<LockStats*> statsList;
+
+} // namespace
+
+// Called by the lock holder, so each lock is pushed once
+void LockStats::Register() noexcept
+{
+    registered = true;
+    auto head = statsList.load(std::memory_order_relaxed);
+    do {
+        next = head;
+    } while (!statsList.compare_exchange_weak(head, this,
+        std::memory_order_release, std::memory_order_relaxed));
+}
+
+void DumpLockStats() noexcept
+{
+    char buf[160];
+    debug::println("[Lock] name acquired contended wait avg/max ns hold avg/max ns");
+    auto stats = statsList.load(std::memory_order_acquire);
+    for (; stats != nullptr; stats = stats->next) {
+        auto acquired = stats->acquired;
+        auto contended = stats->contended;
+        auto waitAvg = contended == 0 ? 0 : stats->waitCycles / contended;
+        auto holdAvg = acquired == 0 ? 0 : stats->holdCycles / acquired;
+        debug::println({buf, format_to(buf, "[Lock] {} {} {} {}/{} {}/{}",
+            stats->name != nullptr ? stats->name : "?", acquired, contended,
+            CyclesToNs(waitAvg), CyclesToNs(stats->maxWait),
+            CyclesToNs(holdAvg), CyclesToNs(stats->maxHold))});
+    }
+}
+
+} // namespace kernel
+#endif
@@ -0,0 +1,43 @@
+#include "kernel/stacktrace.hpp"
+
+namespace kernel {
+
+namespace {
+
+// Largest distance between two frames accepted as the same stack
+constexpr std::uintptr_t MaxFrameStep = 0x10000;
+
+} // namespace
+
+auto CaptureStackTrace(std::span<std::uintptr_t> out, std::uintptr_t framePointer) noexcept -> std::size_t
+{
+#if defined(__x86_64__)
+    // Each frame starts with the caller's frame pointer followed by the
+    // return address
+    std::size_t depth = 0;
+    auto frame = framePointer;
+    while (depth < out.size() && frame != 0 && (frame & 7) == 0) {
+        auto slots = reinterpret_cast<const std::uintptr_t*>(frame);
+        auto next = slots[0];
+        auto ret = slots[1];
+        if (ret == 0) {
+            break;
+        }
+        out[depth++] = ret;
+        if (next <= frame || next - frame > MaxFrameStep) {
+            break;
+        }
+        frame = next;
+    }
+    return depth;
+#else
+#error "CaptureStackTrace() is not implemented for this architecture"
+#endif
+}
+
+[[gnu::noinline]] auto CaptureStackTrace(std::span<std::uintptr_t> out) noexcept -> std::size_t
+{
+    return CaptureStackTrace(out, reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0)));
+}
+
+} // namespace kernel
@@ -0,0 +1,56 @@
+#include "kernel/symbols.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Defined by the linker script around the code and the table generated by
+// ksymtab.cmake
+extern "C" const char __text_start[];
+extern "C" const char __text_end[];
+extern "C" const char __ksymtab_start[];
+extern "C" const char __ksymtab_end[];
+
+namespace kernel {
+
+namespace symbols_detail {
+
+// Offsets are relative to __text_start, sizes are 0 for symbols without
+// one, which then extend to the next symbol or the end of the text
+struct Entry {
+    std::uint32_t offset;
+    std::uint32_t size;
+    std::uint32_t name;
+};
+
+} // namespace symbols_detail
+
+auto LookupSymbol(std::uintptr_t address) noexcept -> SymbolInfo
+{
+    using namespace symbols_detail;
+    std::uint32_t count;
+    if (std::size_t(__ksymtab_end - __ksymtab_start) < sizeof(count)) {
+        return {};
+    }
+    std::memcpy(&count, __ksymtab_start, sizeof(count));
+    auto entries = reinterpret_cast<const Entry*>(__ksymtab_start + sizeof(count));
+    auto names = reinterpret_cast<const char*>(entries + count);
+    auto textStart = reinterpret_cast<std::uintptr_t>(__text_start);
+    if (address < textStart || address >= reinterpret_cast<std::uintptr_t>(__text_end)) {
+        return {};
+    }
+    auto relative = address - textStart;
+    auto next = std::upper_bound(entries, entries + count, relative,
+        [](std::uintptr_t value, const Entry& entry) {
+            return value < entry.offset;
+        });
+    if (next == entries) {
+        return {};
+    }
+    auto& entry = next[-1];
+    auto offset = relative - entry.offset;
+    if (entry.size != 0 && offset >= entry.size) {
+        return {};
+    }
+    return { names + entry.name, offset };
+}
+
+} // namespace kernel
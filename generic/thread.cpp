@@ -0,0 +1,237 @@
+#include "kernel/thread.hpp"
+#include "kernel/deferred_work.hpp"
+#include "kernel/interrupts.hpp"
+#include "kernel/log.hpp"
+#include "kernel/rcu.hpp"
+#include "kernel/timer.hpp"
+#include "kernel/trace.hpp"
+#include "kernel/util.hpp"
+
+namespace kernel {
+
+namespace thread_detail {
+
+constexpr std::uint64_t TimeSliceNs = 10000000;
+constexpr unsigned IdleWorkBudget = 16;
+
+namespace {
+
+TRACE_EVENT(ContextSwitch, (TraceHex, prev), (TraceHex, next));
+
+} // namespace
+
+// All state is only touched with interrupts disabled
+struct Scheduler {
+    intrusive::List<Thread> runQueue;
+    Thread bootThread;
+    Thread* current = &bootThread;
+    Thread* idle = nullptr;
+    // Finished thread whose stack is freed by the next thread to run
+    Thread* zombie = nullptr;
+    Timer sliceTimer{ SliceExpired, nullptr };
+    bool needResched = false;
+
+    static auto NewThread(Thread::Function fn, void* arg, std::size_t stackSize) -> Thread*
+    {
+        auto top = AllocateThreadStack(stackSize);
+        if (top == nullptr) {
+            return nullptr;
+        }
+        auto place = (ptr_cast(top) - sizeof(Thread)) & ~std::uintptr_t(alignof(std::max_align_t) - 1);
+        auto thread = new (ptr_cast<void*>(place)) Thread();
+        thread->stackTop = top;
+        thread->stackSize = stackSize;
+        thread->fn = fn;
+        thread->arg = arg;
+        thread->sp = InitThreadContext(thread, Start, thread);
+        return thread;
+    }
+
+    void Enqueue(Thread& thread)
+    {
+        thread.state = Thread::State_Ready;
+        runQueue.PushBack(thread);
+        if (current == idle) {
+            needResched = true;
+        } else if (!sliceTimer.Pending()) {
+            sliceTimer.ArmAfter(TimeSliceNs);
+        }
+    }
+
+    // The current thread must already be queued, blocked or finished
+    void Schedule()
+    {
+        RCUQuiescentState();
+        needResched = false;
+        Thread* next = idle;
+        if (!runQueue.Empty()) {
+            next = &*runQueue.Begin();
+            runQueue.Erase(*next);
+        }
+        if (runQueue.Empty()) {
+            sliceTimer.Cancel();
+        } else {
+            sliceTimer.ArmAfter(TimeSliceNs);
+        }
+        next->state = Thread::State_Running;
+        if (next == current) {
+            return;
+        }
+        auto prev = current;
+        current = next;
+        TRACE(ContextSwitch, TraceHex(ptr_cast(prev)), TraceHex(ptr_cast(next)));
+        SwitchThreadContext(&prev->sp, next->sp);
+        ReapZombie();
+    }
+
+    void YieldCurrent()
+    {
+        if (runQueue.Empty()) {
+            return;
+        }
+        if (current != idle) {
+            current->state = Thread::State_Ready;
+            runQueue.PushBack(*current);
+        }
+        Schedule();
+    }
+
+    void BlockCurrent()
+    {
+        if (current->wakePending) {
+            current->wakePending = false;
+            return;
+        }
+        current->state = Thread::State_Blocked;
+        Schedule();
+    }
+
+    [[noreturn]] void ExitCurrent()
+    {
+        current->state = Thread::State_Finished;
+        if (current != &bootThread) {
+            zombie = current;
+        }
+        Schedule();
+        __builtin_unreachable();
+    }
+
+    void ReapZombie()
+    {
+        if (zombie != nullptr && zombie != current) {
+            FreeThreadStack(zombie->stackTop, zombie->stackSize);
+            zombie = nullptr;
+        }
+    }
+
+    void Init()
+    {
+        bootThread.state = Thread::State_Running;
+        idle = NewThread(Idle, nullptr, Thread::DefaultStackSize);
+    }
+
+    [[noreturn]] static void Start(void* arg);
+    [[noreturn]] static void Idle(void*);
+    static void SliceExpired(void*);
+};
+
+namespace {
+
+constinit Scheduler scheduler;
+
+} // namespace
+
+void Scheduler::Start(void* arg)
+{
+    scheduler.ReapZombie();
+    EnableInterrupts();
+    auto& self = *static_cast<Thread*>(arg);
+    self.fn(self.arg);
+    ExitThread();
+}
+
+void Scheduler::Idle(void*)
+{
+    while (true) {
+        FlushLog();
+        RunDeferredWork(IdleWorkBudget);
+        auto state = SaveAndDisableInterrupts();
+        if (!scheduler.runQueue.Empty()) {
+            scheduler.Schedule();
+        } else if (!DeferredWorkPending()) {
+            RCUQuiescentState();
+            WaitForInterrupt();
+        }
+        RestoreInterrupts(state);
+    }
+}
+
+// Runs in deferred work, the switch happens on the way out of the interrupt
+void Scheduler::SliceExpired(void*)
+{
+    InterruptGuard guard;
+    scheduler.needResched = true;
+}
+
+} // namespace thread_detail
+
+auto Thread::Create(Function fn, void* arg, std::size_t stackSize) noexcept -> Thread*
+{
+    using thread_detail::scheduler;
+    auto thread = thread_detail::Scheduler::NewThread(fn, arg, stackSize);
+    if (thread != nullptr) {
+        InterruptGuard guard;
+        scheduler.Enqueue(*thread);
+    }
+    return thread;
+}
+
+auto Thread::Current() noexcept -> Thread&
+{
+    return *thread_detail::scheduler.current;
+}
+
+void Thread::Wake() noexcept
+{
+    InterruptGuard guard;
+    if (state == State_Blocked) {
+        thread_detail::scheduler.Enqueue(*this);
+    } else if (state != State_Finished) {
+        wakePending = true;
+    }
+}
+
+void Yield() noexcept
+{
+    InterruptGuard guard;
+    thread_detail::scheduler.YieldCurrent();
+}
+
+void Block() noexcept
+{
+    InterruptGuard guard;
+    thread_detail::scheduler.BlockCurrent();
+}
+
+void ExitThread() noexcept
+{
+    SaveAndDisableInterrupts();
+    thread_detail::scheduler.ExitCurrent();
+}
+
+void InitThreads() noexcept
+{
+    InterruptGuard guard;
+    thread_detail::scheduler.Init();
+}
+
+void PreemptFromInterrupt() noexcept
+{
+    using thread_detail::scheduler;
+    if (scheduler.needResched) {
+        scheduler.needResched = false;
+        scheduler.YieldCurrent();
+    }
+}
+
+} // namespace kernel
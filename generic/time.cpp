@@ -0,0 +1,20 @@
+#include "kernel/time.hpp"
+
+namespace kernel {
+
+namespace time_detail {
+
+constinit Clock clock{};
+
+} // namespace time_detail
+
+void InitClock(std::uint64_t frequency) noexcept
+{
+    using namespace time_detail;
+    clock.frequency = frequency;
+    clock.nsMult = std::uint64_t((uint128_t(NsPerSecond) << ScaleShift) / frequency);
+    clock.cyclesMult = std::uint64_t((uint128_t(frequency) << ScaleShift) / NsPerSecond);
+    clock.base = Cycles();
+}
+
+} // namespace kernel
@@ -0,0 +1,223 @@
+#include "kernel/timer.hpp"
+#include <algorithm>
+#include <bit>
+#include <utility>
+#include "kernel/deferred_work.hpp"
+#include "kernel/interrupts.hpp"
+#include "kernel/spinlock.hpp"
+
+namespace kernel {
+
+namespace timer_detail {
+
+// Timers are filed by distance from the wheel time: level L holds those due
+// in [64^L, 64^(L+1)) ticks, in the slot of their level L digit. A slot is
+// cascaded into the lower levels when the wheel time reaches the tick where
+// that digit begins, so only the next event ever has to be programmed.
+struct Wheel {
+    using TimerList = intrusive::List<Timer>;
+
+    static constexpr std::uint8_t Expired = Levels;
+    static constexpr std::uint64_t Span = std::uint64_t(1) << (LevelBits * Levels);
+    static constexpr std::uint64_t NoEvent = ~std::uint64_t(0);
+
+    // Any CPU may arm or cancel, but only the bootstrap processor's timer
+    // is programmed and only it owns programmed
+    TicketLock lock{ "timer" };
+    TimerList slots[Levels][LevelSlots];
+    TimerList expired;
+    std::uint64_t occupied[Levels] = {};
+    std::uint64_t now = 0;
+    std::uint64_t programmed = NoEvent;
+
+    static auto Digit(std::uint64_t tick, unsigned level) -> unsigned
+    {
+        return (tick >> (level * LevelBits)) & (LevelSlots - 1);
+    }
+
+    void Insert(Timer& timer)
+    {
+        if (timer.expires <= now) {
+            timer.level = Expired;
+            expired.PushBack(timer);
+            return;
+        }
+        auto delta = std::min(timer.expires - now, Span - 1);
+        auto level = unsigned(std::bit_width(delta) - 1) / LevelBits;
+        auto slot = Digit(now + delta, level);
+        timer.level = std::uint8_t(level);
+        timer.slot = std::uint8_t(slot);
+        slots[level][slot].PushBack(timer);
+        occupied[level] |= std::uint64_t(1) << slot;
+    }
+
+    void Remove(Timer& timer)
+    {
+        if (timer.level == Expired) {
+            expired.Erase(timer);
+        } else {
+            auto& list = slots[timer.level][timer.slot];
+            list.Erase(timer);
+            if (list.Empty()) {
+                occupied[timer.level] &= ~(std::uint64_t(1) << timer.slot);
+            }
+        }
+        timer.level = Timer::Idle;
+    }
+
+    // Earliest tick at which some slot has to be cascaded or fired
+    auto NextEvent() -> std::uint64_t
+    {
+        auto next = NoEvent;
+        for (unsigned level = 0; level < Levels; ++level) {
+            auto bits = occupied[level];
+            if (bits == 0) {
+                continue;
+            }
+            auto shift = level * LevelBits;
+            auto rotation = std::uint64_t(1) << (shift + LevelBits);
+            auto base = now & ~(rotation - 1);
+            auto digit = Digit(now, level);
+            auto ahead = digit == LevelSlots - 1 ? 0 : bits & (~std::uint64_t(0) << (digit + 1));
+            if (ahead == 0) {
+                base += rotation;
+                ahead = bits;
+            }
+            next = std::min(next, base + (std::uint64_t(std::countr_zero(ahead)) << shift));
+        }
+        return next;
+    }
+
+    void Cascade(unsigned level, unsigned slot)
+    {
+        auto batch = std::move(slots[level][slot]);
+        slots[level][slot].Clear();
+        occupied[level] &= ~(std::uint64_t(1) << slot);
+        while (!batch.Empty()) {
+            auto& timer = *batch.Begin();
+            batch.Erase(timer);
+            Insert(timer);
+        }
+    }
+
+    // Moves the wheel time to target, collecting due timers into expired
+    void Advance(std::uint64_t target)
+    {
+        for (auto next = NextEvent(); next <= target; next = NextEvent()) {
+            now = next;
+            for (unsigned level = 0; level < Levels; ++level) {
+                if (now & ((std::uint64_t(1) << (level * LevelBits)) - 1)) {
+                    break;
+                }
+                auto slot = Digit(now, level);
+                if (occupied[level] & (std::uint64_t(1) << slot)) {
+                    Cascade(level, slot);
+                }
+            }
+        }
+        now = std::max(now, target);
+    }
+
+    void Reprogram();
+    static void Run(void*, std::uint32_t);
+};
+
+namespace {
+
+constinit Wheel wheel;
+constinit DeferredWork timerWork{ Wheel::Run, nullptr };
+
+auto NowTick() -> std::uint64_t
+{
+    return Now() >> TickShift;
+}
+
+} // namespace
+
+void Wheel::Reprogram()
+{
+    if (!expired.Empty()) {
+        timerWork.Schedule();
+    }
+    auto next = NextEvent();
+    if (next == programmed) {
+        return;
+    }
+    // Other CPUs leave programming to Run on the bootstrap processor
+    if (this_cpu().index != 0) {
+        timerWork.Schedule();
+        return;
+    }
+    programmed = next;
+    if (next == NoEvent) {
+        StopTimerDeadline();
+        return;
+    }
+    // Convert relative to the current cycle count so multiplier rounding
+    // stays proportional to the distance rather than the uptime
+    auto cycles = Cycles();
+    auto nowNs = CyclesToNs(cycles - time_detail::clock.base);
+    auto dueNs = next << TickShift;
+    SetTimerDeadline(cycles + (dueNs > nowNs ? NsToCycles(dueNs - nowNs) + 1 : 0));
+}
+
+void Wheel::Run(void*, std::uint32_t)
+{
+    auto state = SaveAndDisableInterrupts();
+    wheel.lock.Lock();
+    wheel.Advance(NowTick());
+    while (!wheel.expired.Empty()) {
+        auto& timer = *wheel.expired.Begin();
+        wheel.Remove(timer);
+        auto fn = timer.fn;
+        auto ctx = timer.ctx;
+        wheel.lock.Unlock();
+        RestoreInterrupts(state);
+        fn(ctx);
+        state = SaveAndDisableInterrupts();
+        wheel.lock.Lock();
+    }
+    wheel.Reprogram();
+    wheel.lock.Unlock();
+    RestoreInterrupts(state);
+}
+
+} // namespace timer_detail
+
+void Timer::Arm(std::uint64_t deadline) noexcept
+{
+    using namespace timer_detail;
+    auto tick = (deadline >> TickShift) + ((deadline & ((1 << TickShift) - 1)) != 0);
+    SpinLockGuard guard(wheel.lock);
+    if (level != Idle) {
+        wheel.Remove(*this);
+    }
+    expires = tick;
+    wheel.Advance(NowTick());
+    wheel.Insert(*this);
+    wheel.Reprogram();
+}
+
+bool Timer::Cancel() noexcept
+{
+    // The hardware deadline is left as is, an interrupt with nothing due
+    // just reprograms it
+    SpinLockGuard guard(timer_detail::wheel.lock);
+    if (level == Idle) {
+        return false;
+    }
+    timer_detail::wheel.Remove(*this);
+    return true;
+}
+
+void TimerInterrupt() noexcept
+{
+    using namespace timer_detail;
+    {
+        SpinLockGuard guard(wheel.lock);
+        wheel.programmed = Wheel::NoEvent;
+    }
+    timerWork.Schedule();
+}
+
+} // namespace kernel
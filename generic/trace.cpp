@@ -0,0 +1,186 @@
+#include "kernel/trace.hpp"
+#include <atomic>
+#include "kernel/cpu.hpp"
+#include "kernel/format.hpp"
+#include "kernel/interrupts.hpp"
+#include "kernel/log.hpp"
+#include "kernel/spinlock.hpp"
+#include "kernel/spsc_ring.hpp"
+#include "kernel/util.hpp"
+
+// Defined by the linker script around the descriptors TRACE_EVENT() emits
+extern "C" kernel::TraceEvent __trace_events_start[];
+extern "C" kernel::TraceEvent __trace_events_end[];
+
+namespace kernel {
+
+namespace trace_detail {
+
+constexpr std::size_t RingSize = 16384;
+constexpr std::size_t MaxLine = 256;
+
+using Ring = SPSCRing<unsigned char, RingSize>;
+
+namespace {
+
+// Rings are allocated for the CPUs online when an event is first enabled
+// and kept from then on. Each is filled by its CPU with interrupts disabled
+// and emptied by the one running dump.
+constinit TicketLock lock{ "trace" };
+constinit PerCPURings<Ring> rings;
+std::atomic<bool> dumping;
+std::atomic<std::uint64_t> dropped;
+
+auto FieldValue(const unsigned char* payload, const TraceField& field) -> std::uint64_t
+{
+    std::uint64_t value = 0;
+    std::memcpy(&value, payload + field.offset, field.size);
+    auto bits = field.size * 8;
+    if (field.format == TraceFieldFormat::Signed && bits < 64 && (value >> (bits - 1)) & 1) {
+        value |= ~std::uint64_t(0) << bits;
+    }
+    return value;
+}
+
+// "seconds.microseconds cpuN Event field=value ..."
+auto FormatText(char* line, unsigned cpu, const Header& header, const unsigned char* payload)
+    -> std::size_t
+{
+    auto& event = *header.event;
+    auto size = format_to(line, MaxLine - 1, "{:6}.{:06} cpu{} {}", header.time / NsPerSecond,
+        header.time % NsPerSecond / 1000, cpu, event.name);
+    for (unsigned i = 0; i < event.fieldCount; ++i) {
+        auto& field = event.fields[i];
+        auto value = FieldValue(payload, field);
+        switch (field.format) {
+        case TraceFieldFormat::Unsigned:
+            size += format_to(line + size, MaxLine - 1 - size, " {}={}", field.name, value);
+            break;
+        case TraceFieldFormat::Signed:
+            size += format_to(line + size, MaxLine - 1 - size, " {}={}", field.name,
+                std::int64_t(value));
+            break;
+        case TraceFieldFormat::Hex:
+            size += format_to(line + size, MaxLine - 1 - size, " {}={:#x}", field.name, value);
+            break;
+        }
+    }
+    line[size++] = '\n';
+    return size;
+}
+
+// One instant event of the Chrome trace event format, CPUs shown as
+// threads. Hex fields become strings since JSON numbers are doubles.
+auto FormatJSON(char* line, unsigned cpu, const Header& header, const unsigned char* payload,
+    bool first) -> std::size_t
+{
+    auto& event = *header.event;
+    auto size = format_to(line, MaxLine - 1,
+        "{}{{\"name\":\"{}\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{}.{:03},\"pid\":0,\"tid\":{},\"args\":{{",
+        first ? "" : ",", event.name, header.time / 1000, header.time % 1000, cpu);
+    for (unsigned i = 0; i < event.fieldCount; ++i) {
+        auto& field = event.fields[i];
+        auto value = FieldValue(payload, field);
+        auto separator = i == 0 ? "" : ",";
+        switch (field.format) {
+        case TraceFieldFormat::Unsigned:
+            size += format_to(line + size, MaxLine - 1 - size, "{}\"{}\":{}", separator,
+                field.name, value);
+            break;
+        case TraceFieldFormat::Signed:
+            size += format_to(line + size, MaxLine - 1 - size, "{}\"{}\":{}", separator,
+                field.name, std::int64_t(value));
+            break;
+        case TraceFieldFormat::Hex:
+            size += format_to(line + size, MaxLine - 1 - size, "{}\"{}\":\"{:#x}\"", separator,
+                field.name, value);
+            break;
+        }
+    }
+    size += format_to(line + size, MaxLine - 1 - size, "}}}}");
+    line[size++] = '\n';
+    return size;
+}
+
+} // namespace
+
+void Write(std::span<const unsigned char> record) noexcept
+{
+    bool written = true;
+    {
+        InterruptGuard guard;
+        if (auto ring = rings.Get(this_cpu().index)) {
+            written = ring->PushAll(record);
+        }
+    }
+    if (!written) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace trace_detail
+
+auto SetTraceEvents(std::string_view name, bool enabled) noexcept -> unsigned
+{
+    using namespace trace_detail;
+    if (enabled) {
+        SpinLockGuard guard(lock);
+        if (!rings.Allocate()) {
+            return 0;
+        }
+    }
+    unsigned matched = 0;
+    for (auto event = __trace_events_start; event != __trace_events_end; ++event) {
+        if (name != "*" && name != event->name) {
+            continue;
+        }
+        SetStaticKey(event->key, enabled);
+        ++matched;
+    }
+    return matched;
+}
+
+void DumpTrace(TraceFormat format) noexcept
+{
+    using namespace trace_detail;
+    if (dumping.exchange(true, std::memory_order_acquire)) {
+        return;
+    }
+    unsigned cpus;
+    {
+        SpinLockGuard guard(lock);
+        cpus = rings.Count();
+    }
+    bool json = format == TraceFormat::ChromeJSON;
+    if (json) {
+        WriteLog("{\"traceEvents\":[\n");
+    }
+    bool first = true;
+    for (unsigned cpu = 0; cpu < cpus; ++cpu) {
+        auto& ring = *rings.Get(cpu);
+        Header header;
+        unsigned char payload[MaxPayload];
+        char line[MaxLine];
+        // Records keep coming in, so each ring gives at most its capacity.
+        // They are published whole, so a header is never without payload.
+        std::size_t taken = 0;
+        while (taken < RingSize && ring.PopAll({ ptr_cast<unsigned char*>(&header), sizeof(header) })) {
+            auto& event = *header.event;
+            ring.PopAll({ payload, event.size });
+            taken += sizeof(header) + event.size;
+            auto size = json ? FormatJSON(line, cpu, header, payload, first) :
+                FormatText(line, cpu, header, payload);
+            first = false;
+            WriteLog({ line, size });
+        }
+    }
+    if (json) {
+        WriteLog("],\"displayTimeUnit\":\"ns\"}\n");
+    }
+    if (auto lost = dropped.exchange(0, std::memory_order_relaxed); lost != 0) {
+        LOG_WARNING("[Trace] {} record(s) dropped", lost);
+    }
+    dumping.store(false, std::memory_order_release);
+}
+
+} // namespace kernel
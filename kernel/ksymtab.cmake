@@ -0,0 +1,67 @@
+# Writes the symbols inside the text of ELF, as listed by NM, to OUTPUT as the
+# .ksymtab section read by LookupSymbol(): a 32-bit count, then one
+# (offset, size, name offset) triple per symbol sorted by address, offsets
+# relative to __text_start, then the zero-terminated names.
+#
+#   cmake -DNM=<nm> -DELF=<kernel> -DOUTPUT=<ksymtab.s> -P ksymtab.cmake
+
+execute_process(
+    COMMAND ${NM} --defined-only --numeric-sort --print-size ${ELF}
+    OUTPUT_VARIABLE listing
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${NM} failed on ${ELF}")
+endif()
+
+foreach(bound IN ITEMS start end)
+    string(REGEX MATCH "([0-9a-f]+) [^\n]*[Tt] __text_${bound}\n" bound_line "${listing}")
+    if(NOT bound_line)
+        message(FATAL_ERROR "${ELF} has no __text_${bound}")
+    endif()
+    set(text_${bound} ${CMAKE_MATCH_1})
+endforeach()
+set(base ${text_start})
+string(LENGTH ${base} digits)
+math(EXPR low_start "${digits} - 8")
+string(SUBSTRING ${base} ${low_start} 8 base_low)
+
+string(REPLACE "\n" ";" lines "${listing}")
+set(count 0)
+set(entries "")
+set(names "")
+set(name_offset 0)
+set(previous "")
+foreach(line IN LISTS lines)
+    if(NOT line MATCHES "^([0-9a-f]+) (([0-9a-f]+) )?[TtWw] (.+)$")
+        continue()
+    endif()
+    set(address ${CMAKE_MATCH_1})
+    set(size ${CMAKE_MATCH_3})
+    set(name ${CMAKE_MATCH_4})
+    # Aliases share an address, the first name wins
+    if(address STRLESS base OR NOT address STRLESS text_end OR address STREQUAL previous)
+        continue()
+    endif()
+    set(previous ${address})
+    if(NOT size)
+        set(size 0)
+    endif()
+    string(SUBSTRING ${address} ${low_start} 8 address_low)
+    math(EXPR offset "(0x${address_low} - 0x${base_low}) & 0xFFFFFFFF" OUTPUT_FORMAT HEXADECIMAL)
+    math(EXPR size "0x${size} & 0xFFFFFFFF" OUTPUT_FORMAT HEXADECIMAL)
+    string(APPEND entries "        .long   ${offset}, ${size}, ${name_offset}\n")
+    string(APPEND names "        .asciz  \"${name}\"\n")
+    string(LENGTH "${name}" length)
+    math(EXPR name_offset "${name_offset} + ${length} + 1")
+    math(EXPR count "${count} + 1")
+endforeach()
+
+file(WRITE ${OUTPUT}
+    "# Generated by ksymtab.cmake from ${ELF}\n"
+    ".section .ksymtab, \"a\"\n"
+    "        .balign 4\n"
+    "        .long   ${count}\n"
+    "${entries}"
+    "${names}"
+)
@@ -1,47 +1,167 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 typedef unsigned char byte;
+typedef int (*comparator)(const void*, const void*);
+
+enum {
+    InsertionSortThreshold = 16,
+    NintherThreshold = 128,
+};
 
 static void memswp(void * restrict a, void * restrict b, size_t size) {
     byte *dst = a;
     byte *src = b;
-    for (size_t i = 0; i < size; ++i, ++dst, ++src) {
-        byte t = *dst;
-        *dst = *src;
-        *src = t;
+    for (; size >= 16; size -= 16, dst += 16, src += 16) {
+        uint64_t t[2], s[2];
+        __builtin_memcpy(t, dst, 16);
+        __builtin_memcpy(s, src, 16);
+        __builtin_memcpy(dst, s, 16);
+        __builtin_memcpy(src, t, 16);
+    }
+    if (size >= 8) {
+        uint64_t t, s;
+        __builtin_memcpy(&t, dst, 8);
+        __builtin_memcpy(&s, src, 8);
+        __builtin_memcpy(dst, &s, 8);
+        __builtin_memcpy(src, &t, 8);
+        size -= 8; dst += 8; src += 8;
+    }
+    if (size >= 4) {
+        uint32_t t, s;
+        __builtin_memcpy(&t, dst, 4);
+        __builtin_memcpy(&s, src, 4);
+        __builtin_memcpy(dst, &s, 4);
+        __builtin_memcpy(src, &t, 4);
+        size -= 4; dst += 4; src += 4;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        byte t = dst[i];
+        dst[i] = src[i];
+        src[i] = t;
     }
 }
 
-void qsort(void* ptr_, size_t count, size_t size, int (*comp)(const void*, const void*))
-{
-    if (count <= 1) {
-        return;
+static void swp(byte *a, byte *b, size_t size) {
+    if (a != b) {
+        memswp(a, b, size);
     }
-    byte *ptr = ptr_;
-    size_t cLeft = 0;
-    size_t cRight = count;
-    size_t center = cRight / 2;
-    while(cLeft < cRight) {
-        while (comp(ptr + cLeft * size, ptr + center * size) < 0) {
-            cLeft += 1;
+}
+
+static byte *median3(byte *a, byte *b, byte *c, comparator comp) {
+    if (comp(a, b) < 0) {
+        if (comp(b, c) < 0) {
+            return b;
         }
-        if (cLeft == cRight) {
-            break;
+        return comp(a, c) < 0 ? c : a;
+    }
+    if (comp(a, c) < 0) {
+        return a;
+    }
+    return comp(b, c) < 0 ? c : b;
+}
+
+static byte *choose_pivot(byte *ptr, size_t count, size_t size, comparator comp) {
+    byte *lo = ptr;
+    byte *mid = ptr + (count / 2) * size;
+    byte *hi = ptr + (count - 1) * size;
+    if (count >= NintherThreshold) {
+        size_t step = (count / 8) * size;
+        lo = median3(lo, lo + step, lo + 2 * step, comp);
+        mid = median3(mid - step, mid, mid + step, comp);
+        hi = median3(hi - 2 * step, hi - step, hi, comp);
+    }
+    return median3(lo, mid, hi, comp);
+}
+
+static void insertion_sort(byte *ptr, size_t count, size_t size, comparator comp) {
+    for (size_t i = 1; i < count; ++i) {
+        byte *cur = ptr + i * size;
+        while (cur != ptr && comp(cur - size, cur) > 0) {
+            memswp(cur - size, cur, size);
+            cur -= size;
+        }
+    }
+}
+
+static void sift_down(byte *ptr, size_t root, size_t count, size_t size, comparator comp) {
+    size_t child;
+    while ((child = 2 * root + 1) < count) {
+        if (child + 1 < count && comp(ptr + child * size, ptr + (child + 1) * size) < 0) {
+            child += 1;
         }
-        while (comp(ptr + (cRight - 1) * size, ptr + center * size) >= 0) {
-            cRight -= 1;
+        if (comp(ptr + root * size, ptr + child * size) >= 0) {
+            return;
         }
-        if (cLeft == cRight) {
+        memswp(ptr + root * size, ptr + child * size, size);
+        root = child;
+    }
+}
+
+static void heap_sort(byte *ptr, size_t count, size_t size, comparator comp) {
+    for (size_t i = count / 2; i > 0;) {
+        sift_down(ptr, --i, count, size, comp);
+    }
+    for (size_t end = count - 1; end > 0; --end) {
+        memswp(ptr, ptr + end * size, size);
+        sift_down(ptr, 0, end, size, comp);
+    }
+}
+
+/* Hoare partition around ptr[0]; returns the final index of the pivot */
+static size_t partition(byte *ptr, size_t count, size_t size, comparator comp) {
+    size_t i = 1;
+    size_t j = count - 1;
+    while (1) {
+        while (i <= j && comp(ptr + i * size, ptr) < 0) {
+            i += 1;
+        }
+        while (i <= j && comp(ptr + j * size, ptr) > 0) {
+            j -= 1;
+        }
+        if (i >= j) {
             break;
         }
-        memswp(ptr + cLeft * size, ptr + (cRight - 1) * size, size);
-        if (cLeft == center) {
-            center = cRight - 1;
+        memswp(ptr + i * size, ptr + j * size, size);
+        i += 1;
+        j -= 1;
+    }
+    swp(ptr, ptr + j * size, size);
+    return j;
+}
+
+static void introsort(byte *ptr, size_t count, size_t size, comparator comp, int depth) {
+    while (count > InsertionSortThreshold) {
+        if (depth-- == 0) {
+            heap_sort(ptr, count, size, comp);
+            return;
+        }
+        swp(ptr, choose_pivot(ptr, count, size, comp), size);
+        size_t p = partition(ptr, count, size, comp);
+        byte *right = ptr + (p + 1) * size;
+        size_t rightCount = count - p - 1;
+        /* recurse into the smaller half to keep the stack depth logarithmic */
+        if (p < rightCount) {
+            introsort(ptr, p, size, comp, depth);
+            ptr = right;
+            count = rightCount;
+        } else {
+            introsort(right, rightCount, size, comp, depth);
+            count = p;
         }
-    };
-    memswp(ptr + cLeft * size, ptr + center * size, size);
-    qsort(ptr, cLeft, size, comp);
-    cLeft += 1;
-    qsort(ptr + cLeft * size, count - cLeft, size, comp);
+    }
+    insertion_sort(ptr, count, size, comp);
+}
+
+void qsort(void* ptr, size_t count, size_t size, int (*comp)(const void*, const void*))
+{
+    if (count <= 1 || size == 0) {
+        return;
+    }
+    int depth = 0;
+    for (size_t n = count; n > 1; n >>= 1) {
+        depth += 2;
+    }
+    introsort(ptr, count, size, comp, depth);
 }
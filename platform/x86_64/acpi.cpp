@@ -0,0 +1,273 @@
+#include <cstring>
+#include <iterator>
+#include "acpi.h"
+#include "alloc.h"
+
+namespace kernel::tgtspec {
+
+namespace {
+
+using byte = unsigned char;
+
+struct RSDP {
+    char signature[8];
+    std::uint8_t checksum;
+    char oemId[6];
+    std::uint8_t revision;
+    std::uint32_t rsdtAddress;
+    std::uint32_t length;
+    std::uint64_t xsdtAddress;
+    std::uint8_t extChecksum;
+    std::uint8_t reserved[3];
+};
+
+constexpr std::size_t RSDPv1Size = 20;
+constexpr std::size_t RSDPv2Size = 36;
+constexpr std::uint64_t EBDAPointer = 0x40E;
+constexpr std::uint64_t BIOSAreaBegin = 0xE0000;
+constexpr std::uint64_t BIOSAreaEnd = 0x100000;
+
+enum MADTEntry {
+    MADTEntry_LocalAPIC = 0,
+    MADTEntry_IOAPIC = 1,
+    MADTEntry_SourceOverride = 2,
+    MADTEntry_LocalAPICNMI = 4,
+    MADTEntry_LocalAPICAddress = 5,
+    MADTEntry_LocalX2APIC = 9,
+    MADTEntry_LocalX2APICNMI = 10,
+};
+
+// Minimal length of each entry type we read, indexed by MADTEntry
+constexpr std::size_t MADTEntriesOffset = 44;
+constexpr std::uint8_t MADTEntryLength[] = { 8, 12, 10, 0, 6, 12, 0, 0, 0, 16, 12 };
+
+enum MADTFlag {
+    MADTFlag_PCATCompat = 1,
+};
+
+enum LocalAPICFlag {
+    LocalAPICFlag_Enabled = 1,
+    LocalAPICFlag_OnlineCapable = 2,
+};
+
+constexpr std::uint32_t AllProcessors = 0xFFFFFFFF;
+
+MADTInfo madt;
+
+template <typename T>
+auto Load(const byte* ptr) -> T
+{
+    T result;
+    std::memcpy(&result, ptr, sizeof(T));
+    return result;
+}
+
+bool Checksum(const void* data, std::size_t size)
+{
+    auto bytes = static_cast<const byte*>(data);
+    byte sum = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+auto ScanRSDP(std::uint64_t pAddr, std::size_t size) -> std::uint64_t
+{
+    auto area = static_cast<byte*>(MapPhysical(pAddr, size));
+    if (area == nullptr) {
+        return 0;
+    }
+    std::uint64_t result = 0;
+    for (std::size_t offset = 0; offset + RSDPv1Size <= size; offset += 16) {
+        if (std::memcmp(area + offset, "RSD PTR ", 8) == 0 &&
+            Checksum(area + offset, RSDPv1Size))
+        {
+            result = pAddr + offset;
+            break;
+        }
+    }
+    UnmapPhysical(area, size);
+    return result;
+}
+
+auto FindRSDP() -> std::uint64_t
+{
+    auto bda = static_cast<byte*>(MapPhysical(EBDAPointer, 2));
+    if (bda == nullptr) {
+        return 0;
+    }
+    auto ebda = std::uint64_t(Load<std::uint16_t>(bda)) << 4;
+    UnmapPhysical(bda, 2);
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        if (auto result = ScanRSDP(ebda, 0x400)) {
+            return result;
+        }
+    }
+    return ScanRSDP(BIOSAreaBegin, BIOSAreaEnd - BIOSAreaBegin);
+}
+
+auto MapTable(std::uint64_t pAddr) -> ACPITableHeader*
+{
+    auto header = static_cast<ACPITableHeader*>(MapPhysical(pAddr, sizeof(ACPITableHeader)));
+    if (header == nullptr) {
+        return nullptr;
+    }
+    auto length = header->length;
+    UnmapPhysical(header, sizeof(ACPITableHeader));
+    if (length < sizeof(ACPITableHeader)) {
+        return nullptr;
+    }
+    auto table = static_cast<ACPITableHeader*>(MapPhysical(pAddr, length));
+    if (table != nullptr && !Checksum(table, length)) {
+        UnmapPhysical(table, length);
+        return nullptr;
+    }
+    return table;
+}
+
+void UnmapTable(ACPITableHeader* table)
+{
+    UnmapPhysical(table, table->length);
+}
+
+auto FindTable(std::uint64_t rsdpAddr, const char* signature) -> ACPITableHeader*
+{
+    auto mapped = MapPhysical(rsdpAddr, RSDPv2Size);
+    if (mapped == nullptr) {
+        return nullptr;
+    }
+    RSDP rsdp;
+    std::memcpy(&rsdp, mapped, RSDPv2Size);
+    bool extended = rsdp.revision >= 2 && rsdp.xsdtAddress != 0 &&
+        rsdp.length == RSDPv2Size && Checksum(mapped, RSDPv2Size);
+    UnmapPhysical(mapped, RSDPv2Size);
+
+    auto root = MapTable(extended ? rsdp.xsdtAddress : rsdp.rsdtAddress);
+    if (root == nullptr) {
+        return nullptr;
+    }
+    std::size_t entrySize = extended ? 8 : 4;
+    auto entries = reinterpret_cast<const byte*>(root) + sizeof(ACPITableHeader);
+    auto count = (root->length - sizeof(ACPITableHeader)) / entrySize;
+    ACPITableHeader* result = nullptr;
+    for (std::size_t i = 0; i < count && result == nullptr; ++i) {
+        auto entry = entries + i * entrySize;
+        auto pAddr = extended ? Load<std::uint64_t>(entry) : Load<std::uint32_t>(entry);
+        auto table = MapTable(pAddr);
+        if (table == nullptr) {
+            continue;
+        }
+        if (std::memcmp(table->signature, signature, 4) == 0) {
+            result = table;
+        } else {
+            UnmapTable(table);
+        }
+    }
+    UnmapTable(root);
+    return result;
+}
+
+void AddCPU(std::uint32_t apicId)
+{
+    for (int i = 0; i < madt.cpuCount; ++i) {
+        if (madt.apicIds[i] == apicId) {
+            return;
+        }
+    }
+    if (madt.cpuCount < MADTInfo::MaxCPUs) {
+        madt.apicIds[madt.cpuCount++] = apicId;
+    }
+}
+
+void SetNMI(std::uint32_t uid, std::uint8_t lint, std::uint16_t flags)
+{
+    if (madt.nmiLint == MADTInfo::NoLint || uid == AllProcessors) {
+        madt.nmiLint = lint;
+        madt.nmiFlags = flags;
+    }
+}
+
+bool ParseMADT(const ACPITableHeader* table)
+{
+    auto base = reinterpret_cast<const byte*>(table);
+    madt.nmiLint = MADTInfo::NoLint;
+    for (int i = 0; i < MADTInfo::ISAIrqCount; ++i) {
+        madt.isaIrqs[i] = { std::uint32_t(i), 0 };
+    }
+    // The local APIC address and flags end the fixed part of the table
+    if (table->length < MADTEntriesOffset) {
+        return false;
+    }
+    madt.lapicAddress = Load<std::uint32_t>(base + 36);
+    madt.legacyPIC = Load<std::uint32_t>(base + 40) & MADTFlag_PCATCompat;
+    auto end = base + table->length;
+    for (auto p = base + MADTEntriesOffset; end - p >= 2; p += p[1]) {
+        auto type = p[0];
+        auto length = p[1];
+        if (length < 2 || length > end - p) {
+            break;
+        }
+        if (type < std::size(MADTEntryLength) && length < MADTEntryLength[type]) {
+            break;
+        }
+        switch (type) {
+        case MADTEntry_LocalAPIC:
+            if (Load<std::uint32_t>(p + 4) & LocalAPICFlag_Enabled) {
+                AddCPU(p[3]);
+            }
+            break;
+        case MADTEntry_LocalX2APIC:
+            if (Load<std::uint32_t>(p + 8) & LocalAPICFlag_Enabled) {
+                AddCPU(Load<std::uint32_t>(p + 4));
+            }
+            break;
+        case MADTEntry_IOAPIC:
+            if (madt.ioapicCount < MADTInfo::MaxIOAPICs) {
+                madt.ioapics[madt.ioapicCount++] = {
+                    Load<std::uint32_t>(p + 4), Load<std::uint32_t>(p + 8), p[2]
+                };
+            }
+            break;
+        case MADTEntry_SourceOverride:
+            if (p[2] == 0 && p[3] < MADTInfo::ISAIrqCount) {
+                madt.isaIrqs[p[3]] = { Load<std::uint32_t>(p + 4), Load<std::uint16_t>(p + 8) };
+            }
+            break;
+        case MADTEntry_LocalAPICNMI:
+            SetNMI(p[2] == 0xFF ? AllProcessors : p[2], p[5], Load<std::uint16_t>(p + 3));
+            break;
+        case MADTEntry_LocalX2APICNMI:
+            SetNMI(Load<std::uint32_t>(p + 4), p[8], Load<std::uint16_t>(p + 2));
+            break;
+        case MADTEntry_LocalAPICAddress:
+            madt.lapicAddress = Load<std::uint64_t>(p + 4);
+            break;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool InitACPI()
+{
+    auto rsdp = FindRSDP();
+    if (rsdp == 0) {
+        return false;
+    }
+    auto table = FindTable(rsdp, "APIC");
+    if (table == nullptr) {
+        return false;
+    }
+    auto valid = ParseMADT(table);
+    UnmapTable(table);
+    return valid;
+}
+
+auto GetMADT() -> const MADTInfo&
+{
+    return madt;
+}
+
+} // namespace kernel::tgtspec
@@ -0,0 +1,71 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <cstdint>
+
+namespace kernel::tgtspec {
+
+struct ACPITableHeader {
+    char signature[4];
+    std::uint32_t length;
+    std::uint8_t revision;
+    std::uint8_t checksum;
+    char oemId[6];
+    char oemTableId[8];
+    std::uint32_t oemRevision;
+    std::uint32_t creatorId;
+    std::uint32_t creatorRevision;
+};
+
+enum MPSIntiFlag {
+    MPSIntiFlag_PolarityMask = 3,
+    MPSIntiFlag_ActiveHigh = 1,
+    MPSIntiFlag_ActiveLow = 3,
+    MPSIntiFlag_TriggerMask = 3 << 2,
+    MPSIntiFlag_Edge = 1 << 2,
+    MPSIntiFlag_Level = 3 << 2,
+};
+
+struct IOAPICInfo {
+    std::uint64_t address;
+    std::uint32_t gsiBase;
+    std::uint8_t id;
+};
+
+struct ISAIrqRoute {
+    std::uint32_t gsi;
+    std::uint16_t flags;
+};
+
+struct MADTInfo {
+    static constexpr int MaxCPUs = 64;
+    static constexpr int MaxIOAPICs = 8;
+    static constexpr int ISAIrqCount = 16;
+    static constexpr std::uint8_t NoLint = 0xFF;
+
+    std::uint64_t lapicAddress;
+    bool legacyPIC;
+    int cpuCount;
+    std::uint32_t apicIds[MaxCPUs];
+    int ioapicCount;
+    IOAPICInfo ioapics[MaxIOAPICs];
+    ISAIrqRoute isaIrqs[ISAIrqCount];
+    std::uint8_t nmiLint;
+    std::uint16_t nmiFlags;
+};
+
+/**
+ * Locates the RSDP in the BIOS areas and parses the MADT. Must run after
+ * InitAllocator because tables are accessed through MapPhysical.
+ */
+bool InitACPI();
+
+/**
+ * Interrupt controller topology from the MADT, cpuCount is 0 when no MADT
+ * was found.
+ */
+auto GetMADT() -> const MADTInfo&;
+
+} // namespace kernel::tgtspec
+
+#endif // ACPI_H
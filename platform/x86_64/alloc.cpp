@@ -36,9 +36,17 @@
 #include <new>
 #include "kernel/bootdata.h"
 #include "kernel/debug.h"
+#include "kernel/format.hpp"
+#include "kernel/heap_profile.hpp"
+#include "kernel/page_magazine.hpp"
 #include "kernel/util.hpp"
 #include "kernel/avl_tree.hpp"
-#include "kernel/list.hpp"
+#include "kernel/percpu_counter.hpp"
+#include "kernel/slist.hpp"
+#include "kernel/sort.hpp"
+#include "kernel/spinlock.hpp"
+#include "kernel/trace.hpp"
+#include "alloc.h"
 #include "processor.h"
 #include <cstring>
 #include <algorithm>
@@ -67,6 +75,20 @@ extern "C" alignas(PageSize) unsigned char __smheap_end[];
 namespace {
 
 std::uint64_t zeroPage;
+std::uint64_t lowMemoryPage;
+// Serialises everything reached through Allocator::Instance() once other
+// CPUs and interrupt handlers can allocate
+constinit MCSLock allocLock{ "alloc" };
+using AllocGuard = SpinLockGuard<MCSLock>;
+// Taken by page magazines for batch transfers to and from BuddyAlloc
+constinit TicketLock buddyLock{ "buddy" };
+constinit PerCpuStats<MemoryEvents> memoryEvents;
+
+TRACE_EVENT(PageMap, (TraceHex, address), (TraceHex, page));
+TRACE_EVENT(PageUnmap, (TraceHex, address), (TraceHex, page));
+// order is that of the larger block
+TRACE_EVENT(BuddySplit, (TraceHex, block), (std::uint8_t, order));
+TRACE_EVENT(BuddyMerge, (TraceHex, block), (std::uint8_t, order));
 
 auto FindMemoryMap(const kernel_LdrData* data) -> const kernel_MemoryMap*
 {
@@ -101,6 +123,12 @@ auto CanonizeAddr(std::uintptr_t addr) -> std::uintptr_t
 struct ISinglePageAlloc {
     virtual auto alloc() -> std::uint64_t = 0;
     virtual void free(std::uint64_t) = 0;
+    // True if alloc() may return pages with stale contents, the Mapper
+    // clears those once they are mapped
+    virtual bool DirtyPages() const
+    {
+        return false;
+    }
 };
 
 struct InvalidPageAlloc : ISinglePageAlloc {
@@ -155,6 +183,7 @@ struct Mapper
     {
         auto addr = CanonizeAddr(std::uintptr_t(index) * PageSize);
         x86_64::FlushPageTLB(ptr_cast<void*>(addr));
+        memoryEvents.Add(&MemoryEvents::tlbInvalidations);
     }
     static void Invalidate(std::ptrdiff_t index)
     {
@@ -179,12 +208,16 @@ struct Mapper
     {
         Entry(index) = x86_64::MakePageEntry(
             newPage, x86_64::PageEntryFlag_Present | x86_64::PageEntryFlag_Write);
+        memoryEvents.Add(&MemoryEvents::pagesMapped);
+        TRACE(PageMap, TraceHex(CanonizeAddr(std::uintptr_t(index) * PageSize)), TraceHex(newPage));
     }
     static auto Reset(std::ptrdiff_t index) -> uint64_t
     {
         auto& t = Entry(index);
         auto ptr = x86_64::PageEntry_GetAddr(t);
         t = {};
+        memoryEvents.Add(&MemoryEvents::pagesUnmapped);
+        TRACE(PageUnmap, TraceHex(CanonizeAddr(std::uintptr_t(index) * PageSize)), TraceHex(ptr));
         Invalidate(index);
         return ptr;
     }
@@ -196,6 +229,8 @@ struct Mapper
     {
         EntryByAddr(vAddr) = x86_64::MakePageEntry(
             pAddr, x86_64::PageEntryFlag_Present | x86_64::PageEntryFlag_Write);
+        memoryEvents.Add(&MemoryEvents::pagesMapped);
+        TRACE(PageMap, TraceHex(vAddr), TraceHex(pAddr));
         InvalidateByAddr(vAddr);
         return ptr_cast<void*>(vAddr);
     }
@@ -203,6 +238,7 @@ struct Mapper
         std::ptrdiff_t begin, std::ptrdiff_t end,
         ISinglePageAlloc* alloc)
     {
+        auto clear = alloc->DirtyPages();
         for (auto i = begin; i < end; ++i) {
             auto p = alloc->alloc();
             if (p == InvalidPage) {
@@ -210,6 +246,10 @@ struct Mapper
                 return false;
             }
             Set(i, p);
+            // Through the recursive mapping this also covers new tables
+            if (clear) {
+                std::memset(ptr_cast<void*>(CanonizeAddr(std::uintptr_t(i) * PageSize)), 0, PageSize);
+            }
         }
         return true;
     }
@@ -546,9 +586,9 @@ constexpr auto align(std::size_t size, std::size_t align) -> std::size_t
 template <class T, std::size_t storageSize>
 struct chunked_mem_pool
 {
-    using list_node = kernel::intrusive::ListNode<>;
+    using list_node = kernel::intrusive::SListNode<>;
     struct free_obj : list_node {};
-    using list = kernel::intrusive::List<free_obj>;
+    using list = kernel::intrusive::SList<free_obj>;
 
     static constexpr auto max_align = std::max(alignof(T), alignof(free_obj));
     static constexpr auto max_size = std::max(sizeof(T), sizeof(free_obj));
@@ -560,7 +600,7 @@ struct chunked_mem_pool
         auto current = static_cast<unsigned char*>(storage);
         for (ptrdiff_t i = 0; i < objs_per_storage; ++i) {
             auto& obj = *new(current) free_obj;
-            freeObjs.PushBack(obj);
+            freeObjs.PushFront(obj);
             current += obj_size;
         }
     }
@@ -576,8 +616,7 @@ struct chunked_mem_pool
         if (empty()) {
             return nullptr;
         }
-        auto last = (--freeObjs.End()).operator->();
-        freeObjs.PopBack();
+        auto last = freeObjs.PopFront();
         last->~free_obj();
         return new(last) T(std::forward<Init>(init)...);
     }
@@ -586,7 +625,7 @@ struct chunked_mem_pool
     void free(T* obj)
     {
         obj->~T();
-        freeObjs.PushBack(*new(obj) free_obj);
+        freeObjs.PushFront(*new(obj) free_obj);
     }
 
     list freeObjs;
@@ -711,7 +750,7 @@ struct BuddyAlloc final : ISinglePageAlloc {
         auto bitmapSize = (range.end - range.begin) / PageSize;
         std::ptrdiff_t bitmapElemCount = (bitmapSize + 31) / 32;
         std::ptrdiff_t listsOffset = alignUp(sizeof(std::uint32_t) * bitmapElemCount, alignof(std::uint64_t));
-        std::ptrdiff_t arraysSize = listsOffset + levelCount * sizeof(std::uint64_t);
+        std::ptrdiff_t arraysSize = listsOffset + 2 * levelCount * sizeof(std::uint64_t);
         auto hdrRange = vmm.AcquireRange(arraysSize);
         if (hdrRange.begin == hdrRange.end) {
             std::terminate();
@@ -722,6 +761,7 @@ struct BuddyAlloc final : ISinglePageAlloc {
         auto storage = ptr_cast<byte*>(hdrRange.begin);
         bitmap = new(storage) std::uint32_t[bitmapElemCount];
         freeListHeads = new(storage + listsOffset) std::uint64_t[levelCount];
+        freeBlocks = new(freeListHeads + levelCount) std::uint64_t[levelCount]{};
         for (int i = 0; i <= maxLevel; ++i) {
             freeListHeads[i] = InvalidPage;
         }
@@ -785,6 +825,7 @@ private:
         }
         CreateBlock(block, std::uint64_t(InvalidPage), freeListHeads[level]);
         freeListHeads[level] = block;
+        ++freeBlocks[level];
         return true;
     }
 
@@ -803,6 +844,7 @@ private:
         } else {
             freeListHeads[level] = copy.next;
         }
+        --freeBlocks[level];
     }
 
     auto GetNeighbor(int level, std::uint64_t block) const -> std::uint64_t
@@ -828,8 +870,10 @@ private:
                 break;
             }
             EraseFromList(level, GetNeighbor(level, block));
+            memoryEvents.Add(&MemoryEvents::buddyMerges);
             block = GetUpper(level, block);
             ++level;
+            TRACE(BuddyMerge, TraceHex(block), std::uint8_t(level));
         }
     }
 
@@ -841,6 +885,7 @@ private:
         }
         auto copy = DestroyBlock(block);
         freeListHeads[level] = copy.next;
+        --freeBlocks[level];
         if (TogglePair(level, GetPairNum(level, block))) {
             std::terminate();
         }
@@ -872,6 +917,8 @@ private:
             if (!InsertIntoList(currentLevel, GetNeighbor(currentLevel, block))) {
                 std::terminate();
             }
+            memoryEvents.Add(&MemoryEvents::buddySplits);
+            TRACE(BuddySplit, TraceHex(block), std::uint8_t(currentLevel + 1));
         }
         return block;
     }
@@ -889,6 +936,12 @@ public:
         }
     }
 
+    // Single block of 2^level pages, InvalidPage if there is none
+    auto AllocPages(int level) -> std::uint64_t
+    {
+        return level <= maxLevel ? AllocBlock(level) : std::uint64_t(InvalidPage);
+    }
+
     // ISinglePageAlloc interface
     std::uint64_t alloc() override
     {
@@ -900,36 +953,88 @@ public:
         InsertBlock(0, page);
     }
 
-    void DebugDumpLists()
-    {
-        namespace d = debug;
-        d::println("[Buddy lists]");
-        auto s = std::uint64_t(PageSize);
-        char buf[17];
-        for (int i = 0; i <= maxLevel; ++i, s <<= 1) {
-            auto next = freeListHeads[i];
-            kernel::UToStr(buf, 17, s, 16);
-            d::puts(buf); d::putc(':');
-            while (next != InvalidPage) {
-                kernel::UToStr(buf, 17, next, 16);
-                d::putc(' '); d::puts(buf);
-                auto elem = MapExisting(next);
-                next = elem->next;
-                UnmapBlock(elem);
-            }
-            d::putc('\n');
-        }
-        d::putc('\n');
+    auto Orders() const -> int
+    {
+        return maxLevel + 1;
+    }
+
+    auto FreeBlocks(int level) const -> std::uint64_t
+    {
+        return freeBlocks[level];
     }
 private:
     PhyRange range;
     std::uint64_t* freeListHeads;
+    // Length of each free list
+    std::uint64_t* freeBlocks;
     std::uint32_t* bitmap;
     int maxLevel;
     const kernel_MemoryMapEntry* entries;
     std::ptrdiff_t count;
 };
 
+// Per-CPU magazines of single pages in front of BuddyAlloc, so the buddy
+// lists, pair bits and the mapping window are touched once per batch
+// rather than per page. Only the first page of a block is cleared by the
+// buddy, so pages are handed out dirty. Every caller reaches the cache
+// through Allocator::Instance() and so still holds allocLock; the
+// magazines only take the buddy work out of that section for now.
+struct PageCache final : ISinglePageAlloc {
+    using Magazine = PageMagazine<4, PageSize>;
+
+    explicit PageCache(BuddyAlloc& buddy) :
+        buddy(buddy),
+        magazines{}
+    {}
+
+    auto alloc() -> std::uint64_t override
+    {
+        InterruptGuard guard;
+        auto& mag = magazines[this_cpu().index];
+        if (mag.Empty() && !Refill(mag)) [[unlikely]] {
+            return InvalidPage;
+        }
+        return mag.Pop();
+    }
+
+    void free(std::uint64_t page) override
+    {
+        InterruptGuard guard;
+        auto& mag = magazines[this_cpu().index];
+        if (mag.Full()) [[unlikely]] {
+            memoryEvents.Add(&MemoryEvents::cacheDrains);
+            SpinLockGuard lock(buddyLock);
+            mag.Drain(buddy);
+        }
+        mag.Push(page);
+    }
+
+    bool DirtyPages() const override
+    {
+        return true;
+    }
+
+    auto CachedPages() const -> std::uint64_t
+    {
+        std::uint64_t sum = 0;
+        auto count = CPUCount();
+        for (unsigned cpu = 0; cpu < count; ++cpu) {
+            sum += __atomic_load_n(&magazines[cpu].count, __ATOMIC_RELAXED);
+        }
+        return sum;
+    }
+private:
+    bool Refill(Magazine& mag)
+    {
+        memoryEvents.Add(&MemoryEvents::cacheRefills);
+        SpinLockGuard lock(buddyLock);
+        return mag.Refill(buddy);
+    }
+
+    BuddyAlloc& buddy;
+    Magazine magazines[MaxCPUs];
+};
+
 struct VMM
 {
     using mem_range = BasicVMM::mem_range;
@@ -1026,6 +1131,11 @@ struct VMM
         }
         r.end = std::max(r.begin, r.end);
     }
+
+    auto RangeCount() const -> std::size_t
+    {
+        return ranges;
+    }
 private:
     auto AcquireIdealMatch(free_range* node) -> mem_range
     {
@@ -1052,12 +1162,14 @@ private:
     {
         addressTree.Insert(node);
         sizeTree.Insert(node);
+        ++ranges;
     }
 
     void Erase(free_range& node)
     {
         addressTree.Erase(node);
         sizeTree.Erase(node);
+        --ranges;
     }
 
     enum class by_end : std::uintptr_t {};
@@ -1107,6 +1219,7 @@ private:
     using size_tree_t = kernel::intrusive::AVLTree<free_range, size_comp, kernel::intrusive::BaseClassCastPolicy<size_node, free_range>>;
     address_tree_t addressTree;
     size_tree_t sizeTree;
+    std::size_t ranges = 0;
 };
 
 struct memory_range
@@ -1137,7 +1250,8 @@ struct Allocator {
 
     Allocator(BuddyAlloc&& buddy, const BasicVMM& vmm) :
         pmm(buddy),
-        vmm(pmm, vmm)
+        vmm(pmm, vmm),
+        pages(pmm)
     {}
 
     static auto Instance() -> Allocator&
@@ -1153,31 +1267,83 @@ struct Allocator {
             return { nullptr, 0 };
         }
         ptrdiff_t size = range.end - range.begin;
-        if (!Mapper::MapWithAlloc(range.begin, size, &pmm)) [[unlikely]] {
+        if (!Mapper::MapWithAlloc(range.begin, size, &pages)) [[unlikely]] {
             vmm.ReleaseRange(range);
             return { nullptr, 0 };
         }
-        pmm.DebugDumpLists();
         return { ptr_cast<void*>(range.begin), size };
     }
 
+    auto MapPhysicalRange(std::uint64_t pAddr, std::size_t s, std::uint64_t pageFlags) -> void*
+    {
+        auto offset = pAddr & PageMask;
+        auto range = vmm.AcquireRange(s + offset);
+        if (range.begin == range.end) [[unlikely]] {
+            return nullptr;
+        }
+        ptrdiff_t size = range.end - range.begin;
+        if (!Mapper::Map(range.begin, size, pAddr - offset, &pages)) [[unlikely]] {
+            vmm.ReleaseRange(range);
+            return nullptr;
+        }
+        if (pageFlags != 0) {
+            auto begin = Mapper::IndexOf(range.begin);
+            auto end = Mapper::IndexOf(range.end);
+            for (auto i = begin; i != end; ++i) {
+                Mapper::Entry(i).data |= pageFlags;
+            }
+        }
+        return ptr_cast<void*>(range.begin + offset);
+    }
+
+    auto AllocStack(std::size_t s) -> void*
+    {
+        auto range = vmm.AcquireRange(s + PageSize);
+        if (range.begin == range.end) [[unlikely]] {
+            return nullptr;
+        }
+        auto bottom = range.begin + PageSize;
+        if (!Mapper::MapWithAlloc(bottom, range.end - bottom, &pages)) [[unlikely]] {
+            vmm.ReleaseRange(range);
+            return nullptr;
+        }
+        return ptr_cast<void*>(range.end);
+    }
+
+    void FreeStack(void* top, std::size_t s)
+    {
+        auto end = ptr_cast<std::uintptr_t>(top);
+        auto size = align(s, PageSize);
+        Mapper::UnmapWithAlloc(end - size, size, &pages);
+        vmm.ReleaseRange({ end - size - PageSize, end });
+    }
+
+    void UnmapPhysicalRange(void* p, std::size_t s)
+    {
+        auto addr = ptr_cast<std::uintptr_t>(p);
+        auto offset = addr & PageMask;
+        VMM::mem_range range{ addr - offset, addr - offset + align(s + offset, PageSize) };
+        Mapper::Unmap(range.begin, range.end - range.begin, &pages);
+        vmm.ReleaseRange(range);
+    }
+
     void FreeMemoryRange(const memory_range& r)
     {
         VMM::mem_range range{ ptr_cast<std::uintptr_t>(r.begin), ptr_cast<std::uintptr_t>(r.begin) + r.size };
         auto& valloc = vmm;
-        Mapper::UnmapWithAlloc(range.begin, r.size, &pmm);
+        Mapper::UnmapWithAlloc(range.begin, r.size, &pages);
         valloc.ReleaseRange(range);
-        pmm.DebugDumpLists();
     }
 
     BuddyAlloc pmm;
     VMM vmm;
+    PageCache pages;
 };
 
 bool VMM::AutoExtendStorage(mem_range& r)
 {
     if (memPool.empty()) [[unlikely]] {
-        auto& alloc = Allocator::Instance().pmm;
+        auto& alloc = Allocator::Instance().pages;
         if (!Mapper::MapWithAlloc(r.begin, PageSize, &alloc)) {
             std::terminate();
         }
@@ -1209,6 +1375,10 @@ int InitAllocator()
             this->entries = new kernel_MemoryMapEntry[map->count];
             count = map->count;
             std::memcpy(this->entries, entries, sizeof(kernel_MemoryMapEntry) * map->count);
+            kernel::sort(this->entries, this->entries + count,
+                [](const kernel_MemoryMapEntry& a, const kernel_MemoryMapEntry& b) {
+                    return a.begin < b.begin;
+                });
         }
         ~RgCheckDealloc()
         {
@@ -1219,6 +1389,11 @@ int InitAllocator()
             if (!IsAvailRg(entries, count, page)) {
                 return;
             }
+            // Pages come highest first, keep the first usable one
+            if (lowMemoryPage == 0 && page != 0) {
+                lowMemoryPage = page;
+                return;
+            }
             alloc.pmm.free(page);
         }
         Allocator& alloc;
@@ -1230,51 +1405,204 @@ int InitAllocator()
     return 0;
 }
 
-extern "C" void* malloc(size_t s)
+auto GetLowMemoryPage() -> std::uint64_t
+{
+    return lowMemoryPage;
+}
+
+bool MapIdentity(std::uint64_t pAddr, std::size_t size)
+{
+    AllocGuard guard(allocLock);
+    auto begin = alignDown(pAddr, PageSize);
+    auto end = alignUp(pAddr + size, PageSize);
+    return Mapper::Map(begin, end - begin, begin, &Allocator::Instance().pages);
+}
+
+void UnmapIdentity(std::uint64_t pAddr, std::size_t size)
+{
+    AllocGuard guard(allocLock);
+    auto begin = alignDown(pAddr, PageSize);
+    auto end = alignUp(pAddr + size, PageSize);
+    Mapper::Unmap(begin, end - begin, &Allocator::Instance().pages);
+}
+
+auto MapPhysical(std::uint64_t pAddr, std::size_t size, int flags) -> void*
+{
+    std::uint64_t pageFlags = 0;
+    if (flags & MapFlag_NoCache) {
+        pageFlags |= x86_64::PageEntryFlag_PCD | x86_64::PageEntryFlag_PWT;
+    }
+    AllocGuard guard(allocLock);
+    return Allocator::Instance().MapPhysicalRange(pAddr, size, pageFlags);
+}
+
+void UnmapPhysical(void* vAddr, std::size_t size)
+{
+    AllocGuard guard(allocLock);
+    Allocator::Instance().UnmapPhysicalRange(vAddr, size);
+}
+
+auto AllocateStack(std::size_t size) -> void*
+{
+    AllocGuard guard(allocLock);
+    return Allocator::Instance().AllocStack(size);
+}
+
+void FreeStack(void* top, std::size_t size)
+{
+    AllocGuard guard(allocLock);
+    Allocator::Instance().FreeStack(top, size);
+}
+
+auto GetMemoryStats() -> MemoryStats
+{
+    MemoryStats stats{};
+    stats.events = memoryEvents.Snapshot();
+    AllocGuard guard(allocLock);
+    auto& alloc = Allocator::Instance();
+    stats.vmmRanges = alloc.vmm.RangeCount();
+    stats.cachedPages = alloc.pages.CachedPages();
+    SpinLockGuard lock(buddyLock);
+    stats.orders = std::min(alloc.pmm.Orders(), MemoryStats::MaxOrders);
+    for (int i = 0; i < stats.orders; ++i) {
+        stats.freeBlocks[i] = alloc.pmm.FreeBlocks(i);
+    }
+    return stats;
+}
+
+auto FragmentationIndex(const MemoryStats& stats, int order) -> unsigned
+{
+    std::uint64_t total = 0;
+    std::uint64_t usable = 0;
+    for (int i = 0; i < stats.orders; ++i) {
+        auto pages = stats.freeBlocks[i] << i;
+        total += pages;
+        if (i >= order) {
+            usable += pages;
+        }
+    }
+    if (total == 0) {
+        return 0;
+    }
+    return unsigned((total - usable) * 1000 / total);
+}
+
+void DumpMemoryStats()
+{
+    auto stats = GetMemoryStats();
+    auto& events = stats.events;
+    char buf[160];
+    debug::println({buf, format_to(buf, "[Mem] mapped {} unmapped {} invalidated {} splits {} merges {}",
+        events.pagesMapped, events.pagesUnmapped, events.tlbInvalidations,
+        events.buddySplits, events.buddyMerges)});
+    debug::println({buf, format_to(buf, "[Mem] refills {} drains {} cached pages {} vmm ranges {}",
+        events.cacheRefills, events.cacheDrains, stats.cachedPages, stats.vmmRanges)});
+    debug::println("[Mem] order free blocks fragmentation permille");
+    for (int i = 0; i < stats.orders; ++i) {
+        debug::println({buf, format_to(buf, "[Mem] {} {} {}",
+            i, stats.freeBlocks[i], FragmentationIndex(stats, i))});
+    }
+}
+
+namespace {
+
+constexpr auto HeaderReserve = alignof(max_align_t);
+
+struct MallocHeader {
+    // Of the whole page range, so the low bits are free for flags
+    std::ptrdiff_t size;
+#ifdef KERNEL_HEAP_PROFILE
+    std::uintptr_t site;
+#endif
+};
+
+static_assert(sizeof(MallocHeader) <= HeaderReserve);
+
+#ifdef KERNEL_HEAP_PROFILE
+constexpr std::ptrdiff_t MallocFlag_Sampled = 1;
+#endif
+
+auto HeaderOf(void* p) -> MallocHeader*
+{
+    return as<MallocHeader*>(ptr_cast<unsigned char*>(p) - HeaderReserve);
+}
+
+auto RangeSize(const MallocHeader& header) -> std::ptrdiff_t
+{
+    return header.size & ~std::ptrdiff_t(PageMask);
+}
+
+auto Malloc(std::size_t s, [[maybe_unused]] std::uintptr_t site) -> void*
 {
-    constexpr auto HeaderReserve = alignof(max_align_t);
-    static_assert(sizeof(std::ptrdiff_t) <= HeaderReserve);
     s += HeaderReserve;
     if (s > std::numeric_limits<std::ptrdiff_t>::max()) {
         return nullptr;
     }
     std::ptrdiff_t size = s;
-    auto& alloc = Allocator::Instance();
-    auto range = alloc.AllocMemoryRange(size);
+    memory_range range;
+    {
+        AllocGuard guard(allocLock);
+        range = Allocator::Instance().AllocMemoryRange(size);
+    }
     if (range.size == 0) [[unlikely]] {
         return nullptr;
     }
-    auto ptr = ptr_cast<unsigned char*>(range.begin);
-    new(range.begin) std::ptrdiff_t(range.size);
-    return ptr + HeaderReserve;
+    auto ptr = ptr_cast<unsigned char*>(range.begin) + HeaderReserve;
+    auto header = new(range.begin) MallocHeader{};
+    header->size = range.size;
+#ifdef KERNEL_HEAP_PROFILE
+    header->site = site;
+    if (HeapProfileAlloc(ptr, range.size, site)) {
+        header->size |= MallocFlag_Sampled;
+    }
+#endif
+    return ptr;
 }
 
-extern "C" void free(void* p)
+void Free(void* p)
 {
     if (p == nullptr) {
         return;
     }
-    constexpr auto HeaderReserve = alignof(max_align_t);
-    auto ptr = ptr_cast<unsigned char*>(p) - HeaderReserve;
-    memory_range range{ptr, *kernel::as<std::ptrdiff_t*>(ptr)};
-    auto& alloc = Allocator::Instance();
-    alloc.FreeMemoryRange(range);
+    auto header = HeaderOf(p);
+    memory_range range{ header, RangeSize(*header) };
+#ifdef KERNEL_HEAP_PROFILE
+    HeapProfileFree(p, range.size, header->site, header->size & MallocFlag_Sampled);
+#endif
+    AllocGuard guard(allocLock);
+    Allocator::Instance().FreeMemoryRange(range);
+}
+
+#ifdef KERNEL_HEAP_PROFILE
+auto OperatorNew(std::size_t size, std::uintptr_t site) -> void*
+{
+    auto p = Malloc(size, site);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+#endif
+
+} // namespace
+
+extern "C" void* malloc(size_t s)
+{
+    return Malloc(s, ptr_cast<std::uintptr_t>(__builtin_return_address(0)));
+}
+
+extern "C" void free(void* p)
+{
+    Free(p);
 }
 
 extern "C" void* realloc(void* p, size_t newSize)
 {
-    auto oldSize = [&p]() -> std::ptrdiff_t {
-        constexpr auto HeaderReserve = alignof(max_align_t);
-        if (p == nullptr) {
-            return 0;
-        }
-        auto ptr = ptr_cast<unsigned char*>(p) - HeaderReserve;
-        return *kernel::as<std::ptrdiff_t*>(ptr) - HeaderReserve;
-    }();
+    auto oldSize = p == nullptr ? 0 : RangeSize(*HeaderOf(p)) - std::ptrdiff_t(HeaderReserve);
     if (std::size_t(oldSize) == newSize) {
         return p;
     }
-    auto newPtr = malloc(newSize);
+    auto newPtr = Malloc(newSize, ptr_cast<std::uintptr_t>(__builtin_return_address(0)));
     if (newPtr == nullptr) {
         return nullptr;
     }
@@ -1282,8 +1610,36 @@ extern "C" void* realloc(void* p, size_t newSize)
     if (minSize != 0) {
         std::memcpy(newPtr, p, minSize);
     }
-    free(p);
+    Free(p);
     return newPtr;
 }
 
 }
+
+#ifdef KERNEL_HEAP_PROFILE
+// Replace the library versions, which call malloc() themselves, so that
+// C++ allocations are charged to their caller
+void* operator new(std::size_t size)
+{
+    using namespace kernel;
+    return tgtspec::OperatorNew(size, ptr_cast<std::uintptr_t>(__builtin_return_address(0)));
+}
+
+void* operator new[](std::size_t size)
+{
+    using namespace kernel;
+    return tgtspec::OperatorNew(size, ptr_cast<std::uintptr_t>(__builtin_return_address(0)));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    using namespace kernel;
+    return tgtspec::Malloc(size, ptr_cast<std::uintptr_t>(__builtin_return_address(0)));
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    using namespace kernel;
+    return tgtspec::Malloc(size, ptr_cast<std::uintptr_t>(__builtin_return_address(0)));
+}
+#endif
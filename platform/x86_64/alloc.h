@@ -1,6 +1,7 @@
 #ifndef ALLOC_H
 #define ALLOC_H
 
+#include <cstddef>
 #include <cstdint>
 
 namespace kernel::tgtspec {
@@ -21,6 +22,76 @@ struct VirtualRange {
     std::size_t size;
 };
 
+enum MapFlag {
+    MapFlag_NoCache = 1,
+};
+
+/**
+ * Maps size bytes of physical address space starting at pAddr, which need
+ * not be page aligned, into kernel virtual memory. Returns nullptr on failure.
+ */
+auto MapPhysical(std::uint64_t pAddr, std::size_t size, int flags = 0) -> void*;
+void UnmapPhysical(void* vAddr, std::size_t size);
+
+/**
+ * Allocates a kernel stack of size bytes with an unmapped guard page right
+ * below it. Returns the stack top or nullptr.
+ */
+auto AllocateStack(std::size_t size) -> void*;
+void FreeStack(void* top, std::size_t size);
+
+/**
+ * Physical address of a free page below 1 MiB that InitAllocator kept out
+ * of the page allocator for real mode startup code, 0 if there was none.
+ */
+auto GetLowMemoryPage() -> std::uint64_t;
+
+/**
+ * Maps physical memory at the same virtual address, for code that runs
+ * while paging is being turned on. Only valid in the low canonical half.
+ */
+bool MapIdentity(std::uint64_t pAddr, std::size_t size);
+void UnmapIdentity(std::uint64_t pAddr, std::size_t size);
+
+/**
+ * Page allocator and page table events since boot, counted per CPU.
+ */
+struct MemoryEvents {
+    std::uint64_t pagesMapped;
+    std::uint64_t pagesUnmapped;
+    std::uint64_t tlbInvalidations;
+    std::uint64_t buddySplits;
+    std::uint64_t buddyMerges;
+    std::uint64_t cacheRefills;
+    std::uint64_t cacheDrains;
+};
+
+struct MemoryStats {
+    static constexpr int MaxOrders = 52;
+
+    MemoryEvents events;
+    // Free buddy blocks of 2^order pages
+    std::uint64_t freeBlocks[MaxOrders];
+    int orders;
+    // Free pages held in per-CPU magazines
+    std::uint64_t cachedPages;
+    // Free ranges of kernel virtual address space
+    std::uint64_t vmmRanges;
+};
+
+/**
+ * Snapshot of the counters, the per-order free counts are kept up to date
+ * by the buddy allocator so this never walks its lists.
+ */
+auto GetMemoryStats() -> MemoryStats;
+
+/**
+ * Permille of free buddy memory in blocks too small for an allocation of
+ * 2^order pages: 0 when all of it could serve one, 1000 when none could.
+ */
+auto FragmentationIndex(const MemoryStats& stats, int order) -> unsigned;
+void DumpMemoryStats();
+
 struct PageMM {
     PhysicalRange (*PAlloc)(PageMM* mm, void* helperPage, std::size_t size);
     VirtualRange (*VAlloc)(PageMM* mm, void* page, std::size_t size, int flags, std::uint64_t pArgs);
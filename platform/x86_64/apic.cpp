@@ -0,0 +1,270 @@
+#include "apic.h"
+#include "acpi.h"
+#include "alloc.h"
+#include "interrupts.h"
+#include "processor.h"
+#include "kernel/spinlock.hpp"
+
+namespace kernel::tgtspec {
+
+namespace {
+
+constexpr std::size_t LAPICSize = 0x1000;
+constexpr std::size_t IOAPICSize = 0x20;
+constexpr std::uint64_t APICBaseAddrMask = 0x000FFFFFFFFFF000;
+constexpr std::uint32_t SVRFlag_Enable = 1 << 8;
+
+enum IOAPICReg {
+    IOAPICReg_Version = 1,
+    IOAPICReg_Redirection = 0x10,
+};
+
+enum RedirFlag {
+    RedirFlag_ActiveLow = 1 << 13,
+    RedirFlag_Level = 1 << 15,
+    RedirFlag_Masked = 1 << 16,
+};
+
+struct LocalAPIC {
+    volatile std::uint32_t* mmio;
+    bool x2apic;
+    bool enabled;
+};
+
+struct IOAPIC {
+    volatile std::uint32_t* mmio;
+    std::uint32_t gsiBase;
+    std::uint32_t pinCount;
+    // IOREGSEL and IOWIN form one access, the lock keeps them paired once
+    // masking can happen on any CPU
+    TicketLock lock{ "ioapic" };
+};
+
+LocalAPIC lapic;
+IOAPIC ioapics[MADTInfo::MaxIOAPICs];
+int ioapicCount;
+
+auto IOAPICRead(IOAPIC& io, std::uint32_t reg) -> std::uint32_t
+{
+    io.mmio[0] = reg;
+    return io.mmio[4];
+}
+
+void IOAPICWrite(IOAPIC& io, std::uint32_t reg, std::uint32_t value)
+{
+    io.mmio[0] = reg;
+    io.mmio[4] = value;
+}
+
+auto FindIOAPIC(std::uint32_t gsi) -> IOAPIC*
+{
+    for (int i = 0; i < ioapicCount; ++i) {
+        auto& io = ioapics[i];
+        if (gsi >= io.gsiBase && gsi - io.gsiBase < io.pinCount) {
+            return &io;
+        }
+    }
+    return nullptr;
+}
+
+// MPS INTI polarity and trigger bits map onto the same redirection/LVT bits
+auto PinFlags(std::uint16_t mpsFlags) -> std::uint32_t
+{
+    std::uint32_t flags = 0;
+    if ((mpsFlags & MPSIntiFlag_PolarityMask) == MPSIntiFlag_ActiveLow) {
+        flags |= RedirFlag_ActiveLow;
+    }
+    if ((mpsFlags & MPSIntiFlag_TriggerMask) == MPSIntiFlag_Level) {
+        flags |= RedirFlag_Level;
+    }
+    return flags;
+}
+
+bool MapIOAPICs(const MADTInfo& madt)
+{
+    for (int i = 0; i < madt.ioapicCount; ++i) {
+        auto& info = madt.ioapics[i];
+        auto mmio = MapPhysical(info.address, IOAPICSize, MapFlag_NoCache);
+        if (mmio == nullptr) {
+            break;
+        }
+        auto& io = ioapics[ioapicCount++];
+        io.mmio = static_cast<volatile std::uint32_t*>(mmio);
+        io.gsiBase = info.gsiBase;
+        io.pinCount = ((IOAPICRead(io, IOAPICReg_Version) >> 16) & 0xFF) + 1;
+    }
+    return ioapicCount != 0;
+}
+
+void UnmapIOAPICs()
+{
+    while (ioapicCount != 0) {
+        UnmapPhysical(const_cast<std::uint32_t*>(ioapics[--ioapicCount].mmio), IOAPICSize);
+    }
+}
+
+// Per processor part of the Local APIC setup
+void EnableLocalAPIC(const MADTInfo& madt)
+{
+    auto base = x86_64::ReadMSR(x86_64::MSR_APICBase);
+    x86_64::WriteMSR(x86_64::MSR_APICBase, base | x86_64::APICBaseFlag_Enable);
+    if (lapic.x2apic) {
+        // x2APIC can only be entered from the enabled xAPIC state
+        x86_64::WriteMSR(x86_64::MSR_APICBase,
+            base | x86_64::APICBaseFlag_Enable | x86_64::APICBaseFlag_X2APIC);
+    }
+    LocalAPICWrite(LAPICReg_TPR, 0);
+    LocalAPICWrite(LAPICReg_LVTTimer, LVTFlag_Masked);
+    LocalAPICWrite(LAPICReg_LVTError, LVTFlag_Masked);
+    std::uint32_t lint[2] = { LVTFlag_Masked, LVTFlag_Masked };
+    if (madt.nmiLint < 2) {
+        lint[madt.nmiLint] = LVTFlag_NMI | (PinFlags(madt.nmiFlags) & LVTFlag_ActiveLow);
+    }
+    LocalAPICWrite(LAPICReg_LVTLint0, lint[0]);
+    LocalAPICWrite(LAPICReg_LVTLint1, lint[1]);
+    LocalAPICWrite(LAPICReg_SVR, SVRFlag_Enable | SpuriousVector);
+}
+
+bool InitLocalAPIC(const MADTInfo& madt)
+{
+    auto features = x86_64::CPUID(1);
+    if (!(features.edx & x86_64::CPUIDFeature1_EDX_APIC)) {
+        return false;
+    }
+    lapic.x2apic = features.ecx & x86_64::CPUIDFeature1_ECX_X2APIC;
+    if (!lapic.x2apic) {
+        auto base = x86_64::ReadMSR(x86_64::MSR_APICBase);
+        auto mmio = MapPhysical(base & APICBaseAddrMask, LAPICSize, MapFlag_NoCache);
+        if (mmio == nullptr) {
+            return false;
+        }
+        lapic.mmio = static_cast<volatile std::uint32_t*>(mmio);
+    }
+    EnableLocalAPIC(madt);
+    return true;
+}
+
+void RouteISAIrqs(const MADTInfo& madt, std::uint16_t isaMask)
+{
+    for (int i = 0; i < ioapicCount; ++i) {
+        for (std::uint32_t pin = 0; pin < ioapics[i].pinCount; ++pin) {
+            IOAPICWrite(ioapics[i], IOAPICReg_Redirection + pin * 2, RedirFlag_Masked);
+        }
+    }
+    // An identity mapped ISA IRQ loses its pin when another IRQ is
+    // overridden onto it, as IRQ 0 usually is onto GSI 2
+    std::uint32_t claimed = 0;
+    for (std::uint32_t irq = 0; irq < MADTInfo::ISAIrqCount; ++irq) {
+        auto gsi = madt.isaIrqs[irq].gsi;
+        if (gsi != irq && gsi < MADTInfo::ISAIrqCount) {
+            claimed |= 1U << gsi;
+        }
+    }
+    auto destination = LocalAPICId();
+    for (std::uint32_t irq = 0; irq < MADTInfo::ISAIrqCount; ++irq) {
+        auto& route = madt.isaIrqs[irq];
+        if (route.gsi == irq && (claimed & (1U << irq))) {
+            continue;
+        }
+        auto io = FindIOAPIC(route.gsi);
+        if (io == nullptr) {
+            continue;
+        }
+        auto reg = IOAPICReg_Redirection + (route.gsi - io->gsiBase) * 2;
+        auto low = (IRQVectorBase + irq) | PinFlags(route.flags);
+        if (isaMask & (1U << irq)) {
+            low |= RedirFlag_Masked;
+        }
+        IOAPICWrite(*io, reg + 1, destination << 24);
+        IOAPICWrite(*io, reg, low);
+    }
+}
+
+} // namespace
+
+bool InitAPIC(std::uint16_t isaMask)
+{
+    auto& madt = GetMADT();
+    if (madt.cpuCount == 0 || !MapIOAPICs(madt)) {
+        return false;
+    }
+    if (!InitLocalAPIC(madt)) {
+        UnmapIOAPICs();
+        return false;
+    }
+    RouteISAIrqs(madt, isaMask);
+    lapic.enabled = true;
+    return true;
+}
+
+bool LocalAPICEnabled()
+{
+    return lapic.enabled;
+}
+
+void InitAPLocalAPIC()
+{
+    EnableLocalAPIC(GetMADT());
+}
+
+auto LocalAPICRead(std::uint32_t reg) -> std::uint32_t
+{
+    if (lapic.x2apic) {
+        return std::uint32_t(x86_64::ReadMSR(x86_64::MSR_X2APICBase + (reg >> 4)));
+    }
+    return lapic.mmio[reg / 4];
+}
+
+void LocalAPICWrite(std::uint32_t reg, std::uint32_t value)
+{
+    if (lapic.x2apic) {
+        x86_64::WriteMSR(x86_64::MSR_X2APICBase + (reg >> 4), value);
+        return;
+    }
+    lapic.mmio[reg / 4] = value;
+}
+
+auto LocalAPICId() -> std::uint32_t
+{
+    auto id = LocalAPICRead(LAPICReg_ID);
+    return lapic.x2apic ? id : id >> 24;
+}
+
+void LocalAPICEOI()
+{
+    LocalAPICWrite(LAPICReg_EOI, 0);
+}
+
+void LocalAPICSendIPI(std::uint32_t apicId, std::uint32_t command)
+{
+    if (lapic.x2apic) {
+        x86_64::WriteMSR(x86_64::MSR_X2APICBase + (LAPICReg_ICR >> 4),
+            std::uint64_t(apicId) << 32 | command);
+        return;
+    }
+    // An interrupt handler sending its own IPI between the two writes
+    // would retarget this one
+    auto rflags = x86_64::SaveFlagsAndDisableInterrupts();
+    LocalAPICWrite(LAPICReg_ICRHigh, apicId << 24);
+    LocalAPICWrite(LAPICReg_ICR, command);
+    while (LocalAPICRead(LAPICReg_ICR) & ICRFlag_Pending) {
+        asm volatile("pause");
+    }
+    x86_64::RestoreFlags(rflags);
+}
+
+void IOAPICSetMasked(int isaIrq, bool masked)
+{
+    auto gsi = GetMADT().isaIrqs[isaIrq].gsi;
+    auto io = FindIOAPIC(gsi);
+    if (io == nullptr) {
+        return;
+    }
+    auto reg = IOAPICReg_Redirection + (gsi - io->gsiBase) * 2;
+    SpinLockGuard guard(io->lock);
+    auto low = IOAPICRead(*io, reg);
+    low = masked ? low | RedirFlag_Masked : low & ~std::uint32_t(RedirFlag_Masked);
+    IOAPICWrite(*io, reg, low);
+}
+
+} // namespace kernel::tgtspec
@@ -0,0 +1,80 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <cstdint>
+
+namespace kernel::tgtspec {
+
+enum LAPICReg {
+    LAPICReg_ID = 0x20,
+    LAPICReg_Version = 0x30,
+    LAPICReg_TPR = 0x80,
+    LAPICReg_EOI = 0xB0,
+    LAPICReg_SVR = 0xF0,
+    LAPICReg_ESR = 0x280,
+    LAPICReg_ICR = 0x300,
+    LAPICReg_ICRHigh = 0x310,
+    LAPICReg_LVTTimer = 0x320,
+    LAPICReg_LVTLint0 = 0x350,
+    LAPICReg_LVTLint1 = 0x360,
+    LAPICReg_LVTError = 0x370,
+    LAPICReg_TimerInitial = 0x380,
+    LAPICReg_TimerCurrent = 0x390,
+    LAPICReg_TimerDivide = 0x3E0,
+};
+
+enum LVTFlag {
+    LVTFlag_NMI = 4 << 8,
+    LVTFlag_ExtINT = 7 << 8,
+    LVTFlag_ActiveLow = 1 << 13,
+    LVTFlag_Level = 1 << 15,
+    LVTFlag_Masked = 1 << 16,
+    LVTFlag_TSCDeadline = 2 << 17,
+};
+
+enum ICRFlag {
+    ICRFlag_Init = 5 << 8,
+    ICRFlag_Startup = 6 << 8,
+    ICRFlag_Pending = 1 << 12,
+    ICRFlag_Assert = 1 << 14,
+    ICRFlag_Level = 1 << 15,
+    ICRFlag_AllExcludingSelf = 3 << 18,
+};
+
+constexpr int TimerVector = 0xF0;
+constexpr int WakeupVector = 0xF1;
+constexpr int ProfileVector = 0xF2;
+constexpr int PatchVector = 0xF3;
+constexpr int SpuriousVector = 0xFF;
+
+/**
+ * Switches interrupt delivery to the Local APIC (x2APIC mode when the CPU
+ * supports it) and I/O APICs described by the MADT. ISA IRQ n is routed to
+ * vector IRQVectorBase + n, masked if bit n of isaMask is set. Returns false
+ * and leaves the Local APIC untouched if the APICs can't be used.
+ */
+bool InitAPIC(std::uint16_t isaMask);
+
+bool LocalAPICEnabled();
+
+/**
+ * Enables an application processor's own Local APIC the way InitAPIC set
+ * up the bootstrap processor's one.
+ */
+void InitAPLocalAPIC();
+auto LocalAPICRead(std::uint32_t reg) -> std::uint32_t;
+void LocalAPICWrite(std::uint32_t reg, std::uint32_t value);
+auto LocalAPICId() -> std::uint32_t;
+void LocalAPICEOI();
+
+/**
+ * Sends an IPI with the ICR low word command to one processor and waits
+ * until the Local APIC has accepted it.
+ */
+void LocalAPICSendIPI(std::uint32_t apicId, std::uint32_t command);
+
+void IOAPICSetMasked(int isaIrq, bool masked);
+
+} // namespace kernel::tgtspec
+
+#endif // APIC_H
@@ -0,0 +1,116 @@
+#include "apic_timer.h"
+#include "apic.h"
+#include "interrupts.h"
+#include "processor.h"
+#include "kernel/log.hpp"
+#include "kernel/time.hpp"
+#include "kernel/timer.hpp"
+
+namespace kernel::tgtspec {
+
+namespace {
+
+constexpr std::uint32_t TimerDivideBy16 = 3;
+constexpr std::uint64_t CalibrationNs = 10000000;
+constexpr std::uint32_t MaxCount = 0xFFFFFFFF;
+
+enum TimerMode {
+    TimerMode_None,
+    TimerMode_TSCDeadline,
+    TimerMode_OneShot,
+};
+
+TimerMode mode;
+// Local APIC timer counts per TSC cycle, 32.32 fixed point
+std::uint64_t countsPerCycle;
+
+void TimerHandler(void*, int, InterruptFrame*)
+{
+    LocalAPICEOI();
+    TimerInterrupt();
+}
+
+auto CalibrateOneShot() -> std::uint64_t
+{
+    LocalAPICWrite(LAPICReg_TimerDivide, TimerDivideBy16);
+    LocalAPICWrite(LAPICReg_LVTTimer, LVTFlag_Masked | TimerVector);
+    LocalAPICWrite(LAPICReg_TimerInitial, MaxCount);
+    auto start = Cycles();
+    auto wait = NsToCycles(CalibrationNs);
+    while (Cycles() - start < wait) {}
+    auto counts = MaxCount - LocalAPICRead(LAPICReg_TimerCurrent);
+    auto elapsed = Cycles() - start;
+    LocalAPICWrite(LAPICReg_TimerInitial, 0);
+    return std::uint64_t((uint128_t(counts) << 32) / elapsed);
+}
+
+} // namespace
+
+void InitAPICTimer()
+{
+    if (!LocalAPICEnabled() || CycleFrequency() == 0) {
+        LOG_WARNING("[Timer] no Local APIC timer, timers disabled");
+        return;
+    }
+    RegisterInterruptHandler(TimerVector, TimerHandler, nullptr, InterruptHandlerFlag_Leaf);
+    if (x86_64::CPUID(1).ecx & x86_64::CPUIDFeature1_ECX_TSCDeadline) {
+        LocalAPICWrite(LAPICReg_LVTTimer, LVTFlag_TSCDeadline | TimerVector);
+        // Orders the LVT write before the first deadline MSR write
+        asm volatile("mfence":::"memory");
+        mode = TimerMode_TSCDeadline;
+        LOG_INFO("[Timer] Local APIC TSC-deadline");
+        return;
+    }
+    countsPerCycle = CalibrateOneShot();
+    if (countsPerCycle == 0) {
+        LOG_ERROR("[Timer] Local APIC timer calibration failed");
+        return;
+    }
+    LocalAPICWrite(LAPICReg_LVTTimer, TimerVector);
+    mode = TimerMode_OneShot;
+    auto frequency = std::uint64_t((uint128_t(CycleFrequency()) * countsPerCycle) >> 32);
+    LOG_INFO("[Timer] Local APIC one-shot, {} kHz", frequency / 1000);
+}
+
+} // namespace kernel::tgtspec
+
+namespace kernel {
+
+void SetTimerDeadline(std::uint64_t deadline) noexcept
+{
+    using namespace tgtspec;
+    switch (mode) {
+    case TimerMode_TSCDeadline:
+        // Writing 0 disarms the timer
+        x86_64::WriteMSR(x86_64::MSR_TSCDeadline, deadline == 0 ? 1 : deadline);
+        break;
+    case TimerMode_OneShot: {
+        auto now = Cycles();
+        auto delta = deadline > now ? deadline - now : 0;
+        auto counts = (uint128_t(delta) * countsPerCycle) >> 32;
+        // Too long a wait ends early, the wheel reprograms the remainder
+        LocalAPICWrite(LAPICReg_TimerInitial,
+            std::uint32_t(counts < 1 ? 1 : counts > MaxCount ? MaxCount : counts));
+        break;
+    }
+    case TimerMode_None:
+        break;
+    }
+}
+
+void StopTimerDeadline() noexcept
+{
+    using namespace tgtspec;
+    switch (mode) {
+    case TimerMode_TSCDeadline:
+        x86_64::WriteMSR(x86_64::MSR_TSCDeadline, 0);
+        break;
+    case TimerMode_OneShot:
+        LocalAPICWrite(LAPICReg_TimerInitial, 0);
+        break;
+    case TimerMode_None:
+        break;
+    }
+}
+
+} // namespace kernel
@@ -0,0 +1,15 @@
+#ifndef APIC_TIMER_H
+#define APIC_TIMER_H
+
+namespace kernel::tgtspec {
+
+/**
+ * Drives kernel timers from the Local APIC timer, in TSC-deadline mode when
+ * the CPU has it and one-shot mode calibrated against the TSC otherwise.
+ * Needs the APIC and the TSC clock to be initialised.
+ */
+void InitAPICTimer();
+
+} // namespace kernel::tgtspec
+
+#endif // APIC_TIMER_H
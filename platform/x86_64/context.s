@@ -0,0 +1,31 @@
+.intel_syntax noprefix
+
+.text
+# void kernel_x86_64_SwitchContext(void** save, void* load)
+.global kernel_x86_64_SwitchContext
+.type kernel_x86_64_SwitchContext, @function
+kernel_x86_64_SwitchContext:
+        push    rbp
+        push    rbx
+        push    r12
+        push    r13
+        push    r14
+        push    r15
+        mov     [rdi], rsp
+        mov     rsp, rsi
+        pop     r15
+        pop     r14
+        pop     r13
+        pop     r12
+        pop     rbx
+        pop     rbp
+        ret
+
+# First return target of a new context: calls r13(r12) on a 16 byte
+# aligned stack
+.global kernel_x86_64_ThreadTrampoline
+.type kernel_x86_64_ThreadTrampoline, @function
+kernel_x86_64_ThreadTrampoline:
+        mov     rdi, r12
+        call    r13
+        ud2
@@ -9,18 +9,22 @@ void putc(char ch)
 #endif
 }
 
+// One string instruction for the whole buffer, a single exit under a
+// hypervisor rather than one per character
 void puts(std::string_view str)
 {
-    for (auto&& ch : str) {
-        putc(ch);
-    }
+#ifndef NDEBUG
+    auto data = str.data();
+    auto size = str.size();
+    asm volatile("rep outsb":"+S"(data), "+c"(size):"d"(0xe9):"memory");
+#else
+    (void)str;
+#endif
 }
 
 void puts(const char* cstr)
 {
-    while (*cstr) {
-        putc(*(cstr++));
-    }
+    puts(std::string_view(cstr));
 }
 
 void println(std::string_view str)
@@ -1,6 +1,16 @@
 #include <cstdlib>
 #include "kernel/bootdata.h"
+#include "kernel/log.hpp"
+#include "kernel/thread.hpp"
+#include "acpi.h"
 #include "alloc.h"
+#include "apic_timer.h"
+#include "interrupts.h"
+#include "keyboard.h"
+#include "segment.h"
+#include "smp.h"
+#include "tsc.h"
+#include "uart.h"
 
 int kmain();
 
@@ -8,7 +18,6 @@ namespace kernel::tgtspec {
 
 extern "C" void kernel_x86_64_EnableBasicInterrupts(void) noexcept;
 int InitAllocator(void);
-extern "C" void kernel_x86_64_EnableIRQs(void) noexcept;
 extern "C" void _init();
 
 const kernel_LdrData* loaderData;
@@ -16,9 +25,19 @@ const kernel_LdrData* loaderData;
 extern "C" [[noreturn]] void cpp_start(const kernel_LdrData *data) noexcept
 {
     loaderData = data;
+    InitBootCPU();
     kernel_x86_64_EnableBasicInterrupts();
+    InitTSC();
     InitAllocator();
-    kernel_x86_64_EnableIRQs();
+    InitTSS();
+    InitACPI();
+    EnableIRQs();
+    InitKeyboard();
+    InitUART();
+    InitAPICTimer();
+    InitThreads();
+    StartAPs();
+    FlushLog();
     try {
         _init();
         std::exit(kmain());
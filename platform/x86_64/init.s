@@ -20,6 +20,26 @@ _start:
         mov     gs, eax
         call    cpp_start
 
+# void kernel_x86_64_ReloadSegments(x86_64::GDTR* gdtr)
+.global kernel_x86_64_ReloadSegments
+.type kernel_x86_64_ReloadSegments, @function
+kernel_x86_64_ReloadSegments:
+        lgdt    6[rdi]
+        mov     rax, rsp
+        lea     rcx, 0f[rip]
+        pushq   16
+        push    rax
+        pushfq
+        pushq   8
+        push    rcx
+        iretq
+0:      mov     eax, ss
+        mov     ds, eax
+        mov     es, eax
+        mov     fs, eax
+        mov     gs, eax
+        ret
+
 .global kernel_EndlessLoop
 .type kernel_EndlessLoop, @function
 kernel_EndlessLoop:
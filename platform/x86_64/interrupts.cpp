@@ -1,59 +1,312 @@
 #include "interrupts.h"
+#include "acpi.h"
+#include "apic.h"
 #include "processor.h"
+#include "smp.h"
+#include "kernel/deferred_work.hpp"
+#include "kernel/log.hpp"
+#ifdef KERNEL_IRQ_STATS
+#include "kernel/debug.h"
+#include "kernel/format.hpp"
+#include "kernel/histogram.hpp"
+#include "kernel/time.hpp"
+#endif
+#include "kernel/interrupts.hpp"
+#include "kernel/rcu.hpp"
+#include "kernel/spinlock.hpp"
+#include "kernel/thread.hpp"
+#include "kernel/trace.hpp"
 
 namespace kernel::tgtspec {
 
-void UniversalExceptionHandler(int interrupt_index, InterruptFrame* stackframe);
-void UniversalInterruptHandler(int interrupt_index, InterruptFrame* stackframe);
-static void IRQHandler(int irqN, InterruptFrame* stackframe);
-extern "C" void kernel_x86_64_KeyboardIRQ(void);
+extern "C" x86_64::IDTGate kernel_x86_64_IDT[IDTEntries];
+extern "C" const std::uint64_t kernel_x86_64_LeafStubs[IDTEntries - ExceptionVectors];
 
-extern "C" void kernel_x86_64_SystemInterruptHandler(int interrupt_index,
-    InterruptFrame* stackframeptr)
-{
-    switch (interrupt_index) {
-    case i686::Interrupt_DF:
-    case i686::Interrupt_TS:
-    case i686::Interrupt_NP:
-    case i686::Interrupt_SS:
-    case i686::Interrupt_GP:
-    case i686::Interrupt_PF:
-    case i686::Interrupt_AC:
-        UniversalExceptionHandler(interrupt_index, stackframeptr);
-        break;
-    default:
-        UniversalInterruptHandler(interrupt_index, stackframeptr);
-        break;
-    }
-}
+namespace {
+
+// Registration stores handler last and Dispatch loads it first, so a
+// handler is never seen without its ctx
+struct HandlerEntry {
+    InterruptHandler handler;
+    void* ctx;
+    // original gate offset while the gate points to a leaf stub
+    std::uint64_t fullStub;
+};
+
+constexpr unsigned DeferredWorkBudget = 16;
+
+TRACE_EVENT(IRQEntry, (std::uint8_t, vector));
+TRACE_EVENT(IRQExit, (std::uint8_t, vector));
+
+HandlerEntry handlers[IDTEntries];
+constinit TicketLock registrationLock{ "interrupt handlers" };
+bool apicMode;
+unsigned picMask = 0xFFFF;
+
+#ifdef KERNEL_IRQ_STATS
+// Cycles from dispatcher entry until the handler returned and the
+// interrupt was acknowledged, deferred work excluded. Only the bootstrap
+// processor records: it takes every device IRQ, and per-CPU copies of
+// these histograms would cost MaxCPUs times their size.
+using LatencyHistogram = LogHistogram<3, 32>;
+
+struct VectorStats {
+    LatencyHistogram latency;
+    std::uint64_t dumpedCount;
+};
+
+constinit VectorStats vectorStats[IDTEntries];
+std::uint64_t lastDumpNs;
+#endif
 
 void UniversalExceptionHandler(int interrupt_index, InterruptFrame* stackframe)
 {}
 
-void UniversalInterruptHandler(int interrupt_index, InterruptFrame* stackframe)
-{
-    if (interrupt_index < 0x40) return;
-    if (interrupt_index >= 0x50) return;
-    IRQHandler(interrupt_index - 0x40, stackframe);
-}
-
-void IRQHandler(int irqN, InterruptFrame* stackframe)
+bool IsSpuriousPICIRQ(int irqN)
 {
     switch (irqN) {
     case 7:
-        if (kernel_x86_64_IsSpuriousIRQ(0)) {
-            return;
-        }
-        break;
+        return kernel_x86_64_IsSpuriousIRQ(0);
     case 15:
         if (kernel_x86_64_IsSpuriousIRQ(1)) {
             kernel_x86_64_SendEOI(0);
-            return;
+            return true;
         }
         break;
     }
+    return false;
+}
+
+void IRQHandler(int irqN, const HandlerEntry& entry, InterruptFrame* stackframe)
+{
+    if (!apicMode && IsSpuriousPICIRQ(irqN)) {
+        return;
+    }
+    if (auto handler = __atomic_load_n(&entry.handler, __ATOMIC_ACQUIRE)) {
+        handler(entry.ctx, IRQVectorBase + irqN, stackframe);
+    }
+    if (apicMode) {
+        LocalAPICEOI();
+    } else {
+        kernel_x86_64_SendEOI(irqN >= 8);
+    }
+}
+
+// Deferred work runs with interrupts enabled once the outermost interrupt
+// is acknowledged. Exceptions and vectors on an IST stack never drain it,
+// the latter because a nested instance would restart on the same stack.
+// Deferred work, timers and threads only live on the bootstrap processor.
+bool CanRunDeferredWork(const CPUData& cpu, int interrupt_index)
+{
+    return cpu.index == 0 && cpu.interruptNesting == 1 && interrupt_index >= ExceptionVectors &&
+        (kernel_x86_64_IDT[interrupt_index].flags & 7) == 0;
+}
+
+void Dispatch(int interrupt_index, InterruptFrame* stackframe)
+{
+#ifdef KERNEL_IRQ_STATS
+    auto entryCycles = x86_64::ReadTSC();
+#endif
+    auto& cpu = CurrentCPUData();
+    ++cpu.interruptNesting;
+    TRACE(IRQEntry, std::uint8_t(interrupt_index));
+    auto& entry = handlers[interrupt_index];
+    auto irqN = interrupt_index - IRQVectorBase;
+    if (irqN >= 0 && irqN < IRQCount) {
+        IRQHandler(irqN, entry, stackframe);
+    } else if (auto handler = __atomic_load_n(&entry.handler, __ATOMIC_ACQUIRE)) {
+        handler(entry.ctx, interrupt_index, stackframe);
+    } else if (interrupt_index < ExceptionVectors) {
+        UniversalExceptionHandler(interrupt_index, stackframe);
+    }
+    TRACE(IRQExit, std::uint8_t(interrupt_index));
+#ifdef KERNEL_IRQ_STATS
+    if (cpu.index == 0) {
+        vectorStats[interrupt_index].latency.Record(x86_64::ReadTSC() - entryCycles);
+    }
+#endif
+    bool outermost = CanRunDeferredWork(cpu, interrupt_index);
+    if (outermost && DeferredWorkPending()) {
+        asm volatile("sti":::"memory");
+        // What the budget leaves over gets an interrupt of its own, so the
+        // interrupted thread runs in between; without one it runs here
+        while (RunDeferredWork(DeferredWorkBudget) && !KickDeferredWork()) {
+        }
+        asm volatile("cli":::"memory");
+    }
+    --cpu.interruptNesting;
+    // An external interrupt only arrives with interrupts enabled, so the
+    // outermost one can't have hit a read-side section
+    if (cpu.interruptNesting == 0 && interrupt_index >= ExceptionVectors) {
+        RCUQuiescentState();
+    }
+    // The interrupted thread resumes from here, so nesting must already be
+    // back to its thread context value
+    if (outermost) {
+        PreemptFromInterrupt();
+    }
+}
+
+void SetGateOffset(int vector, std::uint64_t offset)
+{
+    auto& gate = kernel_x86_64_IDT[vector];
+    auto updated = gate;
+    x86_64::IDTGate_SetOffset(updated, offset);
+    x86_64::IDTGate_Store(gate, updated);
+}
+
+} // namespace
 
-    kernel_x86_64_SendEOI(irqN >= 8);
+extern "C" void kernel_x86_64_SystemInterruptHandler(int interrupt_index,
+    InterruptFrame* stackframeptr)
+{
+    Dispatch(interrupt_index, stackframeptr);
+}
+
+extern "C" void kernel_x86_64_LeafInterruptHandler(int interrupt_index)
+{
+    Dispatch(interrupt_index, nullptr);
 }
 
+bool RegisterInterruptHandler(int vector, InterruptHandler handler, void* ctx, int flags)
+{
+    if (vector < 0 || vector >= IDTEntries || handler == nullptr) {
+        return false;
+    }
+    bool leaf = flags & InterruptHandlerFlag_Leaf;
+    if (leaf && vector < ExceptionVectors) {
+        return false;
+    }
+    SpinLockGuard guard(registrationLock);
+    auto& entry = handlers[vector];
+    if (entry.handler != nullptr) {
+        return false;
+    }
+    entry.ctx = ctx;
+    entry.fullStub = leaf ? x86_64::IDTGate_GetOffset(kernel_x86_64_IDT[vector]) : 0;
+    __atomic_store_n(&entry.handler, handler, __ATOMIC_RELEASE);
+    // The full stub reaches the handler too until the gate is switched
+    if (leaf) {
+        SetGateOffset(vector, kernel_x86_64_LeafStubs[vector - ExceptionVectors]);
+    }
+    return true;
+}
+
+void UnregisterInterruptHandler(int vector)
+{
+    if (vector < 0 || vector >= IDTEntries) {
+        return;
+    }
+    SpinLockGuard guard(registrationLock);
+    auto& entry = handlers[vector];
+    if (entry.fullStub != 0) {
+        SetGateOffset(vector, entry.fullStub);
+        entry.fullStub = 0;
+    }
+    // ctx stays for a CPU that has already loaded the handler
+    __atomic_store_n(&entry.handler, nullptr, __ATOMIC_RELEASE);
+}
+
+void SetInterruptStack(int vector, int ist)
+{
+    SpinLockGuard guard(registrationLock);
+    auto& gate = kernel_x86_64_IDT[vector];
+    auto updated = gate;
+    updated.flags = std::uint16_t((gate.flags & ~7U) | (ist & 7));
+    x86_64::IDTGate_Store(gate, updated);
+}
+
+void EnableIRQs()
+{
+    // Remap even when switching to the APIC so stray PIC interrupts can't
+    // land on exception vectors
+    auto firmwareMask = kernel_x86_64_RemapPIC(0xFFFF);
+    apicMode = InitAPIC(std::uint16_t(firmwareMask));
+    if (apicMode) {
+        auto& madt = GetMADT();
+        LOG_INFO("[IRQ] Local APIC id {}, {} CPU(s), {} I/O APIC(s)",
+            LocalAPICId(), madt.cpuCount, madt.ioapicCount);
+    } else {
+        picMask = firmwareMask;
+        kernel_x86_64_SetPICMask(picMask);
+        LOG_INFO("[IRQ] 8259 PIC");
+    }
+    asm volatile("sti");
+}
+
+void MaskIRQ(int irq)
+{
+    if (apicMode) {
+        IOAPICSetMasked(irq, true);
+        return;
+    }
+    picMask |= 1U << irq;
+    kernel_x86_64_SetPICMask(picMask);
+}
+
+void UnmaskIRQ(int irq)
+{
+    if (apicMode) {
+        IOAPICSetMasked(irq, false);
+        return;
+    }
+    picMask &= ~(1U << irq);
+    if (irq >= 8) {
+        picMask &= ~(1U << 2);
+    }
+    kernel_x86_64_SetPICMask(picMask);
+}
+
+#ifdef KERNEL_IRQ_STATS
+void DumpIRQStats()
+{
+    auto now = Now();
+    auto elapsed = now - lastDumpNs;
+    lastDumpNs = now;
+    char buf[128];
+    debug::println("[IRQ] vector count rate/s p50/p99/max ns");
+    for (int vector = 0; vector < IDTEntries; ++vector) {
+        auto& stats = vectorStats[vector];
+        if (stats.latency.Count() == 0) {
+            continue;
+        }
+        // Copy with interrupts off for a consistent snapshot
+        auto rflags = x86_64::SaveFlagsAndDisableInterrupts();
+        auto latency = stats.latency;
+        x86_64::RestoreFlags(rflags);
+        auto count = latency.Count();
+        auto rate = elapsed == 0 ? 0 : (count - stats.dumpedCount) * NsPerSecond / elapsed;
+        stats.dumpedCount = count;
+        debug::println({buf, format_to(buf, "[IRQ] {:#04x} {} {} {}/{}/{}", vector, count, rate,
+            CyclesToNs(latency.Percentile(500)), CyclesToNs(latency.Percentile(990)),
+            CyclesToNs(latency.Max()))});
+    }
+}
+#endif
+
 } // namespace kernel::tgtspec
+
+namespace kernel {
+
+auto SaveAndDisableInterrupts() noexcept -> InterruptState
+{
+    return x86_64::SaveFlagsAndDisableInterrupts();
+}
+
+void RestoreInterrupts(InterruptState state) noexcept
+{
+    x86_64::RestoreFlags(state);
+}
+
+void EnableInterrupts() noexcept
+{
+    asm volatile("sti":::"memory");
+}
+
+void WaitForInterrupt() noexcept
+{
+    // sti holds interrupts off until after the next instruction
+    asm volatile("sti\n\thlt":::"memory");
+}
+
+} // namespace kernel
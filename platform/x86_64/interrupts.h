@@ -29,8 +29,59 @@ struct InterruptFrame {
     std::uint64_t ss;
 };
 
+constexpr int IDTEntries = 256;
+constexpr int ExceptionVectors = 32;
+constexpr int IRQVectorBase = 0x40;
+constexpr int IRQCount = 16;
+
+/**
+ * frame is nullptr for handlers registered with InterruptHandlerFlag_Leaf,
+ * whose entry stub saves only caller-saved registers.
+ */
+using InterruptHandler = void (*)(void* ctx, int vector, InterruptFrame* frame);
+
+enum InterruptHandlerFlag {
+    InterruptHandlerFlag_Leaf = 1,
+};
+
 extern "C" void kernel_x86_64_SendEOI(int both);
 extern "C" int kernel_x86_64_IsSpuriousIRQ(int slave);
+extern "C" auto kernel_x86_64_RemapPIC(unsigned mask) -> unsigned;
+extern "C" void kernel_x86_64_SetPICMask(unsigned mask);
+// Loads the shared IDT on an application processor
+extern "C" void kernel_x86_64_LoadIDT(void);
+
+/**
+ * Picks the interrupt controller, APIC if the MADT describes one and the
+ * 8259 PIC otherwise, and enables interrupts. ISA IRQs keep the masks the
+ * firmware left in the PIC.
+ */
+void EnableIRQs();
+
+/**
+ * Installs handler for vector, one handler per vector. IRQ vectors are
+ * acknowledged after the handler returns. Leaf handlers are refused for
+ * exception vectors. Fails if the vector is already taken.
+ */
+bool RegisterInterruptHandler(int vector, InterruptHandler handler, void* ctx, int flags = 0);
+void UnregisterInterruptHandler(int vector);
+
+/**
+ * Makes vector switch to Interrupt Stack Table entry ist (0 to stay on the
+ * current stack). See ISTIndex in segment.h.
+ */
+void SetInterruptStack(int vector, int ist);
+void MaskIRQ(int irq);
+void UnmaskIRQ(int irq);
+
+#ifdef KERNEL_IRQ_STATS
+/**
+ * Prints count, rate since the previous dump and dispatch latency
+ * percentiles of every vector that fired on the bootstrap processor to
+ * the debug port.
+ */
+void DumpIRQStats();
+#endif
 
 } // namespace kernel::tgtspec
 
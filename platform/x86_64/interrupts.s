@@ -3,11 +3,14 @@
 .text
 .set i, 0
 IDTEntries = 256
+ExceptionVectors = 32
 SizeOfIDT = 16 * IDTEntries
 LimitOfIDT = SizeOfIDT - 1
 
 .section .data.kinterrupts, "aw"
 .align 64
+.global kernel_x86_64_IDT
+kernel_x86_64_IDT:
 idt:
 
 .text
@@ -85,6 +88,60 @@ universal_handler:
         iretq
 .cfi_endproc
 
+# Stubs for handlers registered as leaf, exceptions always take the full path.
+# The CPU aligns the stack to 16 bytes before pushing the 40 byte frame, so
+# after the vector push it is aligned again and needs no adjustment.
+.section .rodata
+.align 8
+.global kernel_x86_64_LeafStubs
+kernel_x86_64_LeafStubs:
+
+.set i, ExceptionVectors
+.rept IDTEntries - ExceptionVectors
+.text
+0:
+.cfi_startproc
+        push    (i ^ 0x80) - 0x80
+.cfi_adjust_cfa_offset 8
+        jmp     leaf_handler
+.cfi_endproc
+.section .rodata
+        .quad   0b
+.set i, i + 1
+.endr
+
+.text
+leaf_handler:
+.cfi_startproc
+.cfi_adjust_cfa_offset 8
+        sub     rsp, 0x50
+.cfi_adjust_cfa_offset 0x50
+        mov      0[rsp], rax
+        mov      8[rsp], rcx
+        mov     16[rsp], rdx
+        mov     24[rsp], rsi
+        mov     32[rsp], rdi
+        mov     40[rsp], r8
+        mov     48[rsp], r9
+        mov     56[rsp], r10
+        mov     64[rsp], r11
+        movzx   edi, byte ptr 0x50[rsp]
+        cld
+        call    kernel_x86_64_LeafInterruptHandler
+        mov     rax,  0[rsp]
+        mov     rcx,  8[rsp]
+        mov     rdx, 16[rsp]
+        mov     rsi, 24[rsp]
+        mov     rdi, 32[rsp]
+        mov     r8 , 40[rsp]
+        mov     r9 , 48[rsp]
+        mov     r10, 56[rsp]
+        mov     r11, 64[rsp]
+        add     rsp, 0x58
+.cfi_adjust_cfa_offset -0x58
+        iretq
+.cfi_endproc
+
 .global kernel_x86_64_EnableBasicInterrupts
 .type kernel_x86_64_EnableBasicInterrupts, @function
 kernel_x86_64_EnableBasicInterrupts:
@@ -110,13 +167,20 @@ kernel_x86_64_EnableBasicInterrupts:
         in      al, 0x71
         ret
 
-.global kernel_x86_64_EnableIRQs
-.type kernel_x86_64_EnableIRQs, @function
-kernel_x86_64_EnableIRQs:
-        in      al, 0x21
-        movzx   esi, al
+.global kernel_x86_64_LoadIDT
+.type kernel_x86_64_LoadIDT, @function
+kernel_x86_64_LoadIDT:
+        lidt    idtr[rip]
+        ret
+
+.global kernel_x86_64_RemapPIC
+.type kernel_x86_64_RemapPIC, @function
+kernel_x86_64_RemapPIC:
         in      al, 0xA1
-        movzx   edi, al
+        movzx   esi, al
+        shl     esi, 8
+        in      al, 0x21
+        or      sil, al
 
         mov     eax, 0x11
         out     0x20, al
@@ -144,15 +208,23 @@ kernel_x86_64_EnableIRQs:
         out     0xA1, al
         out     0x80, al
 
-        mov     eax, esi
+        mov     eax, edi
         out     0x21, al
         out     0x80, al
-        mov     eax, edi
+        mov     al, ah
         out     0xA1, al
         out     0x80, al
 
-        sti
+        mov     eax, esi
+        ret
 
+.global kernel_x86_64_SetPICMask
+.type kernel_x86_64_SetPICMask, @function
+kernel_x86_64_SetPICMask:
+        mov     eax, edi
+        out     0x21, al
+        mov     al, ah
+        out     0xA1, al
         ret
 
 .global kernel_x86_64_SendEOI
@@ -182,13 +254,6 @@ kernel_x86_64_IsSpuriousIRQ:
         and     eax, 0x80
         ret
 
-.global kernel_x86_64_KeyboardIRQ
-.type kernel_x86_64_KeyboardIRQ, @function
-kernel_x86_64_KeyboardIRQ:
-        in      al, 0x60
-        mov     [0xb8000], al
-        ret
-
 .section .rodata
 .align	8
         .skip   6
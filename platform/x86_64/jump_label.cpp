@@ -0,0 +1,115 @@
+#include "kernel/jump_label.hpp"
+#include <atomic>
+#include <cstring>
+#include "apic.h"
+#include "interrupts.h"
+#include "processor.h"
+#include "kernel/cpu.hpp"
+#include "kernel/spinlock.hpp"
+#include "kernel/util.hpp"
+
+// Defined by the linker script around the entries StaticKeyEnabled() emits
+extern "C" const kernel::jump_label_detail::Entry __jump_table_start[];
+extern "C" const kernel::jump_label_detail::Entry __jump_table_end[];
+
+namespace kernel::tgtspec {
+
+namespace {
+
+constexpr std::uint64_t CR0_WP = 1 << 16;
+constexpr std::uint8_t JumpOpcode = 0xE9;
+constexpr std::uint8_t Nop5[] = { 0x0F, 0x1F, 0x44, 0x00, 0x00 };
+constexpr std::size_t SiteSize = sizeof(Nop5);
+
+// Held with interrupts disabled but never waited for that way, since a CPU
+// spinning with interrupts off could not park for the holder
+constinit TicketLock lock{ "jump label" };
+bool registered;
+std::atomic<unsigned> parked;
+std::atomic<bool> patching;
+
+auto Resolve(const void* field, std::int64_t offset) -> std::uintptr_t
+{
+    return ptr_cast(field) + std::uintptr_t(offset);
+}
+
+// Caller runs with CR0.WP clear and every other CPU parked
+void Patch(std::uintptr_t code, std::uintptr_t target, bool enabled)
+{
+    std::uint8_t insn[SiteSize];
+    if (enabled) {
+        auto rel = std::int32_t(target - (code + SiteSize));
+        insn[0] = JumpOpcode;
+        std::memcpy(insn + 1, &rel, sizeof(rel));
+    } else {
+        std::memcpy(insn, Nop5, SiteSize);
+    }
+    std::memcpy(ptr_cast<void*>(code), insn, SiteSize);
+}
+
+// The cross-modifying code protocol of the SDM: the CPU waits until the
+// patch is written, then serializes before it runs any of the new code
+void PatchHandler(void*, int, InterruptFrame*)
+{
+    LocalAPICEOI();
+    parked.fetch_add(1, std::memory_order_acq_rel);
+    while (patching.load(std::memory_order_acquire)) {
+        CPURelax();
+    }
+    x86_64::Serialize();
+}
+
+// Caller holds lock
+void ParkOtherCPUs()
+{
+    auto others = CPUCount() - 1;
+    if (others == 0) {
+        return;
+    }
+    if (!registered) {
+        RegisterInterruptHandler(PatchVector, PatchHandler, nullptr, InterruptHandlerFlag_Leaf);
+        registered = true;
+    }
+    parked.store(0, std::memory_order_relaxed);
+    patching.store(true, std::memory_order_release);
+    LocalAPICSendIPI(0, ICRFlag_AllExcludingSelf | PatchVector);
+    while (parked.load(std::memory_order_acquire) < others) {
+        CPURelax();
+    }
+}
+
+} // namespace
+
+} // namespace kernel::tgtspec
+
+namespace kernel {
+
+void SetStaticKey(StaticKey& key, bool enabled) noexcept
+{
+    using namespace tgtspec;
+    auto rflags = x86_64::SaveFlagsAndDisableInterrupts();
+    while (!lock.TryLock()) {
+        x86_64::RestoreFlags(rflags);
+        CPURelax();
+        rflags = x86_64::SaveFlagsAndDisableInterrupts();
+    }
+    if (key.enabled != enabled) {
+        key.enabled = enabled;
+        ParkOtherCPUs();
+        // Kernel text may be mapped read-only
+        auto cr0 = x86_64::ReadCR0();
+        x86_64::WriteCR0(cr0 & ~CR0_WP);
+        for (auto entry = __jump_table_start; entry != __jump_table_end; ++entry) {
+            if (Resolve(&entry->key, entry->key) != ptr_cast(&key)) {
+                continue;
+            }
+            Patch(Resolve(&entry->code, entry->code), Resolve(&entry->target, entry->target), enabled);
+        }
+        x86_64::WriteCR0(cr0);
+        patching.store(false, std::memory_order_release);
+    }
+    lock.Unlock();
+    x86_64::RestoreFlags(rflags);
+}
+
+} // namespace kernel
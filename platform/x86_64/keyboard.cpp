@@ -0,0 +1,57 @@
+#include "keyboard.h"
+#include "interrupts.h"
+#include "processor.h"
+
+namespace kernel::tgtspec {
+
+namespace {
+
+constexpr int KeyboardIRQ = 1;
+constexpr std::uint16_t PS2DataPort = 0x60;
+
+constinit ScancodeRing scancodes;
+std::atomic<Thread*> consumer;
+std::atomic<std::uint64_t> dropped;
+
+void KeyboardHandler(void*, int, InterruptFrame*)
+{
+    auto scancode = x86_64::InB(PS2DataPort);
+    if (!scancodes.Push(scancode)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (auto thread = consumer.load(std::memory_order_acquire)) {
+        thread->Wake();
+    }
+}
+
+} // namespace
+
+void InitKeyboard()
+{
+    if (!RegisterInterruptHandler(IRQVectorBase + KeyboardIRQ, KeyboardHandler, nullptr,
+        InterruptHandlerFlag_Leaf))
+    {
+        return;
+    }
+    // Drop a byte left over from the firmware so the controller raises IRQ 1 again
+    x86_64::InB(PS2DataPort);
+    UnmaskIRQ(KeyboardIRQ);
+}
+
+auto GetScancodeRing() -> ScancodeRing&
+{
+    return scancodes;
+}
+
+void SetScancodeConsumer(Thread* thread)
+{
+    consumer.store(thread, std::memory_order_release);
+}
+
+auto DroppedScancodes() -> std::uint64_t
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+} // namespace kernel::tgtspec
@@ -0,0 +1,34 @@
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include <cstdint>
+#include "kernel/spsc_ring.hpp"
+#include "kernel/thread.hpp"
+
+namespace kernel::tgtspec {
+
+using ScancodeRing = SPSCRing<std::uint8_t, 256>;
+
+/**
+ * Takes over ISA IRQ 1. The handler only moves the byte from the PS/2 data
+ * port into the scancode ring, dropping it when the ring is full, and
+ * wakes the consumer thread.
+ */
+void InitKeyboard();
+
+/**
+ * Raw set 1 scancodes in arrival order, read with Peek() and Release() by
+ * a single consumer.
+ */
+auto GetScancodeRing() -> ScancodeRing&;
+
+/**
+ * Thread woken whenever scancodes arrive, nullptr for none.
+ */
+void SetScancodeConsumer(Thread* thread);
+
+auto DroppedScancodes() -> std::uint64_t;
+
+} // namespace kernel::tgtspec
+
+#endif // KEYBOARD_H
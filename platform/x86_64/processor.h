@@ -247,9 +247,152 @@ inline PageEntry LoadCR3(void)
     return r;
 }
 
+inline uint64_t ReadCR0(void)
+{
+    uint64_t value;
+    __asm__("mov %%cr0, %0":"=r"(value));
+    return value;
+}
+
+inline void WriteCR0(uint64_t value)
+{
+    __asm__ volatile("mov %0, %%cr0"::"r"(value):"memory");
+}
+
+inline uint64_t ReadCR4(void)
+{
+    uint64_t value;
+    __asm__("mov %%cr4, %0":"=r"(value));
+    return value;
+}
+
+enum MSR {
+    MSR_APICBase = 0x1B,
+    MSR_TSCDeadline = 0x6E0,
+    MSR_X2APICBase = 0x800,
+    MSR_EFER = 0xC0000080,
+    MSR_GSBase = 0xC0000101,
+};
+
+enum APICBaseFlag {
+    APICBaseFlag_BSP = 1 << 8,
+    APICBaseFlag_X2APIC = 1 << 10,
+    APICBaseFlag_Enable = 1 << 11,
+};
+
+inline uint64_t ReadMSR(uint32_t msr)
+{
+    uint32_t low, high;
+    __asm__ volatile("rdmsr":"=a"(low), "=d"(high):"c"(msr));
+    return (uint64_t)high << 32 | low;
+}
+
+inline void WriteMSR(uint32_t msr, uint64_t value)
+{
+    __asm__ volatile("wrmsr"::"c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)):"memory");
+}
+
+inline uint64_t ReadTSC(void)
+{
+    uint32_t low, high;
+    __asm__ volatile("rdtsc":"=a"(low), "=d"(high));
+    return (uint64_t)high << 32 | low;
+}
+
+inline uint8_t InB(uint16_t port)
+{
+    uint8_t value;
+    __asm__ volatile("inb %1, %0":"=a"(value):"Nd"(port));
+    return value;
+}
+
+inline void OutB(uint16_t port, uint8_t value)
+{
+    __asm__ volatile("outb %0, %1"::"a"(value), "Nd"(port));
+}
+
+struct CPUIDResult {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+};
+
+enum CPUIDFeature1 {
+    CPUIDFeature1_ECX_X2APIC = 1 << 21,
+    CPUIDFeature1_ECX_TSCDeadline = 1 << 24,
+    CPUIDFeature1_EDX_APIC = 1 << 9,
+};
+
+enum CPUIDPower {
+    CPUIDPower_EDX_InvariantTSC = 1 << 8,
+};
+
+inline CPUIDResult CPUID(uint32_t leaf, uint32_t subleaf = 0)
+{
+    CPUIDResult r;
+    __asm__ volatile("cpuid":"=a"(r.eax), "=b"(r.ebx), "=c"(r.ecx), "=d"(r.edx):"a"(leaf), "c"(subleaf));
+    return r;
+}
+
+// CPUID as a serializing instruction, ordered against memory accesses
+inline void Serialize(void)
+{
+    uint32_t eax = 0, ebx, ecx = 0, edx;
+    __asm__ volatile("cpuid":"+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx)::"memory");
+}
+
+struct IDTGate {
+    uint16_t offsetLow;
+    uint16_t selector;
+    uint16_t flags;
+    uint16_t offsetMiddle;
+    uint32_t offsetHigh;
+    uint32_t rsv;
+};
+
+inline uint64_t IDTGate_GetOffset(const IDTGate& gate)
+{
+    return (uint64_t)gate.offsetHigh << 32 | (uint32_t)gate.offsetMiddle << 16 | gate.offsetLow;
+}
+
+inline void IDTGate_SetOffset(IDTGate& gate, uint64_t offset)
+{
+    gate.offsetLow = (uint16_t)offset;
+    gate.offsetMiddle = (uint16_t)(offset >> 16);
+    gate.offsetHigh = (uint32_t)(offset >> 32);
+}
+
+// Replaces a gate other CPUs may be reading with one locked 16-byte store,
+// so no CPU sees half of the new offset. The IDT is 16-byte aligned.
+inline void IDTGate_Store(IDTGate& gate, const IDTGate& value)
+{
+    uint64_t desired[2], expected[2];
+    __builtin_memcpy(desired, &value, sizeof(desired));
+    __builtin_memcpy(expected, &gate, sizeof(expected));
+    bool stored;
+    do {
+        __asm__ volatile("lock cmpxchg16b %1"
+            :"=@ccz"(stored), "+m"(gate), "+a"(expected[0]), "+d"(expected[1])
+            :"b"(desired[0]), "c"(desired[1]):"memory");
+    } while (!stored);
+}
+
+inline uint64_t SaveFlagsAndDisableInterrupts(void)
+{
+    uint64_t flags;
+    __asm__ volatile("pushfq\n\tpopq %0\n\tcli":"=r"(flags)::"memory");
+    return flags;
+}
+
+inline void RestoreFlags(uint64_t flags)
+{
+    __asm__ volatile("pushq %0\n\tpopfq"::"r"(flags):"memory", "cc");
+}
+
 struct GDTR {
-    uint32_t rsv0;
-    uint16_t rsv1;
+    uint32_t rsv0 = 0;
+    uint16_t rsv1 = 0;
     uint16_t limit;
     i686::Descriptor* gdt;
 };
@@ -258,6 +401,11 @@ inline void LoadGDT(GDTR *ptr) {
     __asm__ volatile("lgdt 6(%0)"::"r"(ptr));
 }
 
+inline void LoadTR(uint16_t selector) {
+    __asm__ volatile("ltr %0"::"r"(selector));
+}
+
+// The hardware TSS starts at _r0, pad keeps the 64-bit fields aligned
 struct tss {
     uint32_t pad;
     uint32_t _r0;
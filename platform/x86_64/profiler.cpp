@@ -0,0 +1,232 @@
+#include "profiler.h"
+
+#ifdef KERNEL_PROFILER
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include "apic.h"
+#include "interrupts.h"
+#include "processor.h"
+#include "kernel/cpu.hpp"
+#include "kernel/log.hpp"
+#include "kernel/sort.hpp"
+#include "kernel/spinlock.hpp"
+#include "kernel/spsc_ring.hpp"
+#include "kernel/stacktrace.hpp"
+#include "kernel/symbols.hpp"
+
+namespace kernel::tgtspec {
+
+namespace {
+
+constexpr int PITIRQ = 0;
+constexpr std::uint32_t PITFrequency = 1193182;
+constexpr std::uint32_t MinPITDivisor = 2;
+constexpr std::uint32_t MaxPITDivisor = 0xFFFF;
+constexpr std::size_t SampleDepth = 12;
+constexpr std::size_t RingCapacity = 512;
+// Largest distance above the interrupted stack pointer at which rbp is
+// still taken for a frame pointer
+constexpr std::uintptr_t MaxFrameOffset = 0x10000;
+constexpr std::size_t MaxLine = 1024;
+// Room left at the end of a line for the sample count
+constexpr std::size_t CountRoom = 24;
+
+enum Port : std::uint16_t {
+    Port_PITChannel0 = 0x40,
+    Port_PITCommand = 0x43,
+};
+
+// Channel 0, low then high divisor byte, mode 2 (rate generator)
+constexpr std::uint8_t PITRateGenerator = 0x34;
+
+struct Sample {
+    std::uint32_t depth;
+    // Interrupted rip first, then return addresses outwards
+    std::uintptr_t stack[SampleDepth];
+};
+
+using SampleRing = SPSCRing<Sample, RingCapacity>;
+
+// Rings are allocated for the CPUs online when sampling starts and kept
+// from then on. Each is filled by its CPU's sampling interrupt and emptied
+// under lock.
+constinit TicketLock lock{ "profiler" };
+constinit PerCPURings<SampleRing> rings;
+bool registered;
+std::atomic<std::uint64_t> dropped;
+
+void RecordSample(const InterruptFrame& frame)
+{
+    auto ring = rings.Get(this_cpu().index);
+    if (ring == nullptr) {
+        return;
+    }
+    auto span = ring->Reserve(1);
+    if (span.empty()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto& sample = span[0];
+    sample.stack[0] = frame.rip;
+    sample.depth = 1;
+    // Code without a frame pointer may hold anything in rbp, so it is only
+    // followed when it points into the interrupted stack
+    if (frame.rbp - frame.rsp < MaxFrameOffset) {
+        sample.depth += std::uint32_t(CaptureStackTrace({ sample.stack + 1, SampleDepth - 1 }, frame.rbp));
+    }
+    ring->Commit(1);
+}
+
+void PITHandler(void*, int, InterruptFrame* frame)
+{
+    RecordSample(*frame);
+    if (CPUCount() > 1) {
+        LocalAPICSendIPI(0, ICRFlag_AllExcludingSelf | ProfileVector);
+    }
+}
+
+void ProfileHandler(void*, int, InterruptFrame* frame)
+{
+    LocalAPICEOI();
+    RecordSample(*frame);
+}
+
+// Caller holds lock
+bool RegisterHandlers()
+{
+    if (registered) {
+        return true;
+    }
+    if (!RegisterInterruptHandler(IRQVectorBase + PITIRQ, PITHandler, nullptr)) {
+        return false;
+    }
+    if (!RegisterInterruptHandler(ProfileVector, ProfileHandler, nullptr)) {
+        UnregisterInterruptHandler(IRQVectorBase + PITIRQ);
+        return false;
+    }
+    registered = true;
+    return true;
+}
+
+// Every address of a known function becomes the function's start, so
+// samples that differ only in where inside a function they hit compare
+// equal
+void FoldAddresses(Sample& sample)
+{
+    for (std::uint32_t i = 0; i < sample.depth; ++i) {
+        // A return address points past the call, which may already be the
+        // next function when the call doesn't return
+        auto address = i == 0 ? sample.stack[0] : sample.stack[i] - 1;
+        auto symbol = LookupSymbol(address);
+        if (!symbol.name.empty()) {
+            sample.stack[i] = address - symbol.offset;
+        }
+    }
+}
+
+bool StackLess(const Sample& a, const Sample& b)
+{
+    if (a.depth != b.depth) {
+        return a.depth < b.depth;
+    }
+    return std::lexicographical_compare(a.stack, a.stack + a.depth, b.stack, b.stack + b.depth);
+}
+
+bool SameStack(const Sample& a, const Sample& b)
+{
+    return a.depth == b.depth && std::equal(a.stack, a.stack + a.depth, b.stack);
+}
+
+void WriteFolded(const Sample& sample, std::size_t count)
+{
+    char line[MaxLine];
+    std::size_t size = 0;
+    constexpr std::size_t frameRoom = MaxLine - CountRoom;
+    for (auto i = sample.depth; i-- != 0;) {
+        auto address = sample.stack[i];
+        auto name = LookupSymbol(address).name;
+        if (name.empty()) {
+            size += format_to(line + size, frameRoom - size, "0x{:x}", address);
+        } else {
+            size += format_to(line + size, frameRoom - size, "{}", name);
+        }
+        if (i != 0) {
+            size += format_to(line + size, frameRoom - size, ";");
+        }
+    }
+    size += format_to(line + size, MaxLine - size, " {}\n", count);
+    WriteLog({ line, size });
+}
+
+} // namespace
+
+bool StartProfiler(unsigned hz)
+{
+    if (hz == 0) {
+        return false;
+    }
+    auto divisor = std::clamp(PITFrequency / hz, MinPITDivisor, MaxPITDivisor);
+    SpinLockGuard guard(lock);
+    if (!RegisterHandlers() || !rings.Allocate()) {
+        return false;
+    }
+    x86_64::OutB(Port_PITCommand, PITRateGenerator);
+    x86_64::OutB(Port_PITChannel0, std::uint8_t(divisor & 0xFF));
+    x86_64::OutB(Port_PITChannel0, std::uint8_t(divisor >> 8));
+    UnmaskIRQ(PITIRQ);
+    return true;
+}
+
+void StopProfiler()
+{
+    MaskIRQ(PITIRQ);
+}
+
+void ExportProfile()
+{
+    unsigned cpus;
+    {
+        SpinLockGuard guard(lock);
+        cpus = rings.Count();
+    }
+    if (cpus == 0) {
+        return;
+    }
+    auto samples = static_cast<Sample*>(std::malloc(cpus * RingCapacity * sizeof(Sample)));
+    if (samples == nullptr) {
+        LOG_ERROR("[Profiler] No memory to export samples");
+        return;
+    }
+    std::size_t count = 0;
+    {
+        SpinLockGuard guard(lock);
+        // Samples keep coming in, so each ring gives at most its capacity
+        for (unsigned cpu = 0; cpu < cpus; ++cpu) {
+            auto& ring = *rings.Get(cpu);
+            std::size_t taken = 0;
+            for (auto span = ring.Peek(RingCapacity); !span.empty() && taken < RingCapacity;
+                span = ring.Peek(RingCapacity - taken))
+            {
+                std::copy(span.begin(), span.end(), samples + count);
+                count += span.size();
+                taken += span.size();
+                ring.Release(span.size());
+            }
+        }
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        FoldAddresses(samples[i]);
+    }
+    kernel::sort(samples, samples + count, StackLess);
+    for (std::size_t first = 0, last; first < count; first = last) {
+        for (last = first + 1; last < count && SameStack(samples[first], samples[last]); ++last) {}
+        WriteFolded(samples[first], last - first);
+    }
+    std::free(samples);
+    LOG_INFO("[Profiler] {} sample(s) exported, {} dropped", count,
+        dropped.exchange(0, std::memory_order_relaxed));
+}
+
+} // namespace kernel::tgtspec
+#endif
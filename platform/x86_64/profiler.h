@@ -0,0 +1,39 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+
+namespace kernel::tgtspec {
+
+#ifdef KERNEL_PROFILER
+/**
+ * Starts sampling every online CPU about hz times a second: PIT channel 0
+ * interrupts the bootstrap processor, which passes the tick on to the
+ * others with a ProfileVector IPI. Each sample is the interrupted rip and
+ * up to 11 return addresses found through frame pointers, stored in a ring
+ * of the sampling CPU. Code running with interrupts disabled is never
+ * sampled. Rates outside the PIT's 19 Hz to 596 kHz range are clamped.
+ * Needs EnableIRQs() first. Returns false if the vectors are taken or the
+ * rings can't be allocated.
+ */
+bool StartProfiler(unsigned hz);
+
+/**
+ * Masks the PIT interrupt, leaving no sampling cost behind. Samples taken
+ * so far stay until exported.
+ */
+void StopProfiler();
+
+/**
+ * Empties the sample rings and writes the samples to the log sink as
+ * folded stacks, one "outer;...;inner count" line per distinct stack with
+ * mangled names from the embedded symbol table, ready for flame graph
+ * tools once passed through c++filt. Samples that found their ring full
+ * are only counted.
+ */
+void ExportProfile();
+#endif
+
+} // namespace kernel::tgtspec
+
+#endif // PROFILER_H
@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <iterator>
 #include "segment.h"
+#include "alloc.h"
+#include "interrupts.h"
 
 namespace kernel::tgtspec {
 
@@ -6,6 +12,14 @@ namespace {
 using enum i686::DescFlag;
 using enum i686::SegTypeFlag;
 using i686::MakeSegDescriptor;
+
+constexpr std::size_t ISTStackSize = 0x4000;
+constexpr std::uint32_t TSSLimit = sizeof(x86_64::tss) - offsetof(x86_64::tss, _r0) - 1;
+
+auto AllocateISTStack() -> std::uint64_t
+{
+    return reinterpret_cast<std::uint64_t>(AllocateStack(ISTStackSize));
+}
 }
 
 i686::Descriptor gdt[] = {
@@ -15,8 +29,54 @@ i686::Descriptor gdt[] = {
     MakeSegDescriptor(0, 0xFFFFF, 3, DescFlag_LimitIn4K | DescFlag_Long | DescFlag_Present | SegType_ExecRead),
     MakeSegDescriptor(0, 0xFFFFF, 3, DescFlag_LimitIn4K | DescFlag_OP32 | DescFlag_Present | SegType_ReadWrite),
     MakeSegDescriptor(0, 0xFFFFF, 3, DescFlag_LimitIn4K | DescFlag_OP32 | DescFlag_Present | SegType_ExecRead),
+    {}, // TSS, filled by InitTSS
+    {},
 };
 
+static_assert(std::size(gdt) == GDTEntries);
+
 extern "C" x86_64::GDTR gdtr = { .limit = sizeof(gdt) - 1, .gdt = gdt };
 
+extern "C" void kernel_x86_64_ReloadSegments(x86_64::GDTR* gdtr);
+
+bool SetupCPUSegments(CPUData& cpu)
+{
+    auto& tss = cpu.tss;
+    std::uint64_t* stacks[] = { &tss.ist1, &tss.ist2, &tss.ist3, &tss.ist4 };
+    for (auto stack : stacks) {
+        *stack = AllocateISTStack();
+        if (*stack == 0) {
+            return false;
+        }
+    }
+    tss.ioMap = TSSLimit + 1;
+    std::copy(std::begin(gdt), std::end(gdt), cpu.gdt);
+    auto base = reinterpret_cast<std::uint64_t>(&tss._r0);
+    auto index = TSSSelector / sizeof(i686::Descriptor);
+    cpu.gdt[index] = MakeSegDescriptor(std::uint32_t(base), TSSLimit, 0, std::uint32_t(DescFlag_Present) | SegType_TSS32);
+    cpu.gdt[index + 1] = { std::uint32_t(base >> 32), 0 };
+    cpu.gdtr = { .limit = sizeof(cpu.gdt) - 1, .gdt = cpu.gdt };
+    return true;
+}
+
+void LoadCPUSegments(CPUData& cpu)
+{
+    kernel_x86_64_ReloadSegments(&cpu.gdtr);
+    x86_64::LoadTR(TSSSelector);
+    // Loading GS above cleared the base
+    x86_64::WriteMSR(x86_64::MSR_GSBase, reinterpret_cast<std::uint64_t>(&cpu));
+}
+
+void InitTSS()
+{
+    auto& cpu = GetCPUData(0);
+    if (!SetupCPUSegments(cpu)) {
+        std::terminate();
+    }
+    LoadCPUSegments(cpu);
+    SetInterruptStack(i686::Interrupt_DF, IST_DoubleFault);
+    SetInterruptStack(i686::Interrupt_NMI, IST_NMI);
+    SetInterruptStack(i686::Interrupt_MC, IST_MachineCheck);
+}
+
 } // namespace kernel::tgtspec
@@ -10,9 +10,44 @@
 #endif
 
 #include "processor.h"
+#include "smp.h"
 
 extern "C" i686::Descriptor gdt[];
 
+namespace kernel::tgtspec {
+
+constexpr std::uint16_t TSSSelector = 0x30;
+
+enum ISTIndex {
+    IST_None = 0,
+    IST_DoubleFault = 1,
+    IST_NMI = 2,
+    IST_MachineCheck = 3,
+    // Spare stack for a high rate interrupt. A vector on it must not
+    // re-enable interrupts, or a second instance would reuse the stack
+    IST_HighFrequency = 4,
+};
+
+/**
+ * Installs the bootstrap processor's own GDT and TSS with guard paged IST
+ * stacks and moves #DF, NMI and #MC onto them. Needs the allocator.
+ */
+void InitTSS();
+
+/**
+ * Builds cpu's GDT and TSS and allocates its IST stacks. Runs on the CPU
+ * that starts cpu, so the allocator is only used from one processor.
+ */
+bool SetupCPUSegments(CPUData& cpu);
+
+/**
+ * Loads cpu's GDT and TSS on the calling processor and points GS base at
+ * cpu. Segment registers are reloaded.
+ */
+void LoadCPUSegments(CPUData& cpu);
+
+} // namespace kernel::tgtspec
+
 #undef EXTERN_C
 
 #endif // SEGMENT_H
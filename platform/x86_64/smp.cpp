@@ -0,0 +1,229 @@
+#include "smp.h"
+#include <cstring>
+#include "acpi.h"
+#include "alloc.h"
+#include "apic.h"
+#include "interrupts.h"
+#include "segment.h"
+#include "kernel/deferred_work.hpp"
+#include "kernel/log.hpp"
+#include "kernel/executor.hpp"
+#include "kernel/interrupts.hpp"
+#include "kernel/time.hpp"
+#include "kernel/util.hpp"
+
+namespace kernel::tgtspec {
+
+extern "C" const unsigned char kernel_x86_64_APTrampoline[];
+extern "C" const unsigned char kernel_x86_64_APTrampolineParams[];
+extern "C" const unsigned char kernel_x86_64_APTrampolineEnd[];
+
+namespace {
+
+constexpr std::size_t PageSize = 0x1000;
+constexpr std::size_t APStackSize = 0x4000;
+constexpr std::uint64_t InitDelayNs = 10000000;
+constexpr std::uint64_t FirstStartupWaitNs = 1000000;
+constexpr std::uint64_t SecondStartupWaitNs = 100000000;
+constexpr std::uint64_t CR4_PCIDE = 1 << 17;
+
+// Matches the parameter block at the end of trampoline.s
+struct APStartParams {
+    std::uint64_t cr0;
+    std::uint64_t cr3;
+    std::uint64_t cr4;
+    std::uint64_t efer;
+    std::uint64_t stack;
+    std::uint64_t entry;
+    std::uint64_t arg;
+};
+
+static_assert(MaxCPUs == 1 || MADTInfo::MaxCPUs <= int(MaxCPUs));
+
+// Slots are handed out in MADT order and never reused; indices only count
+// the CPUs that came online, so they stay dense
+CPUData cpus[MaxCPUs];
+CPUData* indexed[MaxCPUs];
+std::atomic<unsigned> cpuCount = 1;
+
+bool WaitOnline(CPUData& cpu, std::uint64_t ns)
+{
+    auto deadline = Now() + ns;
+    while (cpu.state.load(std::memory_order_acquire) != CPUState_Online) {
+        if (Now() >= deadline) {
+            return false;
+        }
+        asm volatile("pause");
+    }
+    return true;
+}
+
+bool StartAP(CPUData& cpu, std::uint64_t trampoline)
+{
+    LocalAPICSendIPI(cpu.apicId, ICRFlag_Init | ICRFlag_Assert | ICRFlag_Level);
+    auto deadline = Now() + InitDelayNs;
+    while (Now() < deadline) {
+        asm volatile("pause");
+    }
+    auto sipi = ICRFlag_Startup | std::uint32_t(trampoline >> 12);
+    LocalAPICSendIPI(cpu.apicId, sipi);
+    if (WaitOnline(cpu, FirstStartupWaitNs)) {
+        return true;
+    }
+    LocalAPICSendIPI(cpu.apicId, sipi);
+    if (WaitOnline(cpu, SecondStartupWaitNs)) {
+        return true;
+    }
+    // The processor may still wake up later. If it gets here first it has
+    // come online after all; otherwise INIT puts it back to waiting for a
+    // SIPI, which no later startup addresses to it, before the trampoline
+    // parameters are rewritten for the next processor.
+    int expected = CPUState_Starting;
+    if (!cpu.state.compare_exchange_strong(expected, CPUState_Retired, std::memory_order_acq_rel)) {
+        return true;
+    }
+    LocalAPICSendIPI(cpu.apicId, ICRFlag_Init | ICRFlag_Assert | ICRFlag_Level);
+    return false;
+}
+
+[[noreturn]] void Park()
+{
+    while (true) {
+        asm volatile("cli; hlt");
+    }
+}
+
+void WakeupHandler(void*, int, InterruptFrame*)
+{
+    LocalAPICEOI();
+}
+
+// Set once the wakeup vector has a handler to acknowledge it
+constinit std::atomic<bool> wakeupReady;
+
+} // namespace
+
+extern "C" [[noreturn]] void kernel_x86_64_APEntry(CPUData* cpu)
+{
+    LoadCPUSegments(*cpu);
+    kernel_x86_64_LoadIDT();
+    InitAPLocalAPIC();
+    // Retired before INIT reached it: its index belongs to another CPU now
+    int expected = CPUState_Starting;
+    if (!cpu->state.compare_exchange_strong(expected, CPUState_Online, std::memory_order_acq_rel)) {
+        Park();
+    }
+    RunExecutor();
+}
+
+auto GetCPUData(unsigned index) -> CPUData&
+{
+    return *indexed[index];
+}
+
+void InitBootCPU()
+{
+    auto& cpu = cpus[0];
+    cpu.self = &cpu;
+    cpu.index = 0;
+    cpu.state.store(CPUState_Online, std::memory_order_relaxed);
+    indexed[0] = &cpu;
+    x86_64::WriteMSR(x86_64::MSR_GSBase, reinterpret_cast<std::uint64_t>(&cpu));
+}
+
+void StartAPs()
+{
+    auto& madt = GetMADT();
+    cpus[0].apicId = LocalAPICEnabled() ? LocalAPICId() : 0;
+    if (LocalAPICEnabled()) {
+        RegisterInterruptHandler(WakeupVector, WakeupHandler, nullptr, InterruptHandlerFlag_Leaf);
+        wakeupReady.store(true, std::memory_order_release);
+    }
+    if (MaxCPUs == 1 || madt.cpuCount < 2 || !LocalAPICEnabled() || CycleFrequency() == 0) {
+        return;
+    }
+    auto trampoline = GetLowMemoryPage();
+    auto cr3 = x86_64::PageEntry_GetAddr(x86_64::LoadCR3());
+    if (trampoline == 0 || cr3 >> 32 != 0) {
+        LOG_WARNING("[SMP] can't start APs: no low memory page or page tables above 4 GiB");
+        return;
+    }
+    if (!MapIdentity(trampoline, PageSize)) {
+        return;
+    }
+    auto size = std::size_t(kernel_x86_64_APTrampolineEnd - kernel_x86_64_APTrampoline);
+    auto code = ptr_cast<unsigned char*>(trampoline);
+    std::memcpy(code, kernel_x86_64_APTrampoline, size);
+    auto& params = *reinterpret_cast<APStartParams*>(
+        code + (kernel_x86_64_APTrampolineParams - kernel_x86_64_APTrampoline));
+    params.cr0 = x86_64::ReadCR0();
+    params.cr3 = cr3;
+    // PCID can only be turned on once in long mode
+    params.cr4 = x86_64::ReadCR4() & ~CR4_PCIDE;
+    params.efer = x86_64::ReadMSR(x86_64::MSR_EFER);
+    params.entry = reinterpret_cast<std::uint64_t>(kernel_x86_64_APEntry);
+
+    unsigned slot = 1;
+    unsigned online = 1;
+    for (int i = 0; i < madt.cpuCount && slot < MaxCPUs; ++i) {
+        if (madt.apicIds[i] == cpus[0].apicId) {
+            continue;
+        }
+        auto& cpu = cpus[slot];
+        cpu.self = &cpu;
+        cpu.index = online;
+        cpu.apicId = madt.apicIds[i];
+        auto stack = AllocateStack(APStackSize);
+        if (stack == nullptr || !SetupCPUSegments(cpu)) {
+            break;
+        }
+        params.stack = reinterpret_cast<std::uint64_t>(stack);
+        params.arg = reinterpret_cast<std::uint64_t>(&cpu);
+        cpu.state.store(CPUState_Starting, std::memory_order_release);
+        // The slot and its stack are retired with a processor that fails
+        // to start, in case it still runs on them
+        ++slot;
+        if (!StartAP(cpu, trampoline)) {
+            LOG_WARNING("[SMP] APIC id {} did not start", cpu.apicId);
+            continue;
+        }
+        indexed[online] = &cpu;
+        cpuCount.store(++online, std::memory_order_release);
+    }
+    UnmapIdentity(trampoline, PageSize);
+    LOG_INFO("[SMP] {} CPU(s) online", online);
+}
+
+} // namespace kernel::tgtspec
+
+namespace kernel {
+
+auto CPUCount() noexcept -> unsigned
+{
+    return tgtspec::cpuCount.load(std::memory_order_acquire);
+}
+
+auto GetCPU(unsigned index) noexcept -> CPU&
+{
+    return *tgtspec::indexed[index];
+}
+
+void WakeIdleCPUs() noexcept
+{
+    using namespace tgtspec;
+    if (CPUCount() > 1) {
+        LocalAPICSendIPI(0, ICRFlag_AllExcludingSelf | WakeupVector);
+    }
+}
+
+auto KickDeferredWork() noexcept -> bool
+{
+    using namespace tgtspec;
+    if (!wakeupReady.load(std::memory_order_acquire)) {
+        return false;
+    }
+    LocalAPICSendIPI(cpus[0].apicId, WakeupVector);
+    return true;
+}
+
+} // namespace kernel
@@ -0,0 +1,56 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <atomic>
+#include <cstdint>
+#include "kernel/cpu.hpp"
+#include "processor.h"
+
+namespace kernel::tgtspec {
+
+constexpr int GDTEntries = 8;
+
+enum CPUState {
+    CPUState_Offline,
+    CPUState_Starting,
+    CPUState_Online,
+    // Missed its startup deadline; never reused
+    CPUState_Retired,
+};
+
+/**
+ * Per-CPU block, its address is kept in IA32_GS_BASE. Each CPU has its own
+ * GDT so it can hold that CPU's TSS descriptor.
+ */
+struct CPUData : kernel::CPU {
+    std::uint32_t apicId;
+    std::atomic<int> state;
+    int interruptNesting;
+    i686::Descriptor gdt[GDTEntries];
+    x86_64::GDTR gdtr;
+    x86_64::tss tss;
+};
+
+auto GetCPUData(unsigned index) -> CPUData&;
+
+inline auto CurrentCPUData() -> CPUData&
+{
+    return static_cast<CPUData&>(this_cpu());
+}
+
+/**
+ * Points GS base at the bootstrap processor's block so this_cpu() works
+ * from the start. Its GDT and TSS are set up later by InitTSS.
+ */
+void InitBootCPU();
+
+/**
+ * Starts the application processors listed in the MADT with INIT-SIPI-SIPI
+ * through a real mode trampoline in low memory. Started processors run
+ * kernel::RunExecutor(). Needs the Local APIC and the TSC clock.
+ */
+void StartAPs();
+
+} // namespace kernel::tgtspec
+
+#endif // SMP_H
@@ -0,0 +1,56 @@
+#include "alloc.h"
+#include "kernel/thread.hpp"
+#include "kernel/util.hpp"
+
+namespace kernel {
+
+extern "C" void kernel_x86_64_SwitchContext(void** save, void* load) noexcept;
+extern "C" void kernel_x86_64_ThreadTrampoline() noexcept;
+
+namespace {
+
+// Popped by kernel_x86_64_SwitchContext, lowest address first
+struct InitialContext {
+    std::uint64_t r15;
+    std::uint64_t r14;
+    std::uint64_t r13;
+    std::uint64_t r12;
+    std::uint64_t rbx;
+    std::uint64_t rbp;
+    std::uint64_t ret;
+};
+
+} // namespace
+
+auto InitThreadContext(void* stackTop, void (*start)(void* arg), void* arg) noexcept -> void*
+{
+    auto top = ptr_cast(stackTop) & ~std::uintptr_t(15);
+    auto ctx = ptr_cast<InitialContext*>(top - sizeof(InitialContext));
+    *ctx = {
+        .r15 = 0,
+        .r14 = 0,
+        .r13 = ptr_cast(reinterpret_cast<void*>(start)),
+        .r12 = ptr_cast(arg),
+        .rbx = 0,
+        .rbp = 0,
+        .ret = ptr_cast(reinterpret_cast<void*>(kernel_x86_64_ThreadTrampoline)),
+    };
+    return ctx;
+}
+
+void SwitchThreadContext(void** save, void* load) noexcept
+{
+    kernel_x86_64_SwitchContext(save, load);
+}
+
+auto AllocateThreadStack(std::size_t size) noexcept -> void*
+{
+    return tgtspec::AllocateStack(size);
+}
+
+void FreeThreadStack(void* top, std::size_t size) noexcept
+{
+    tgtspec::FreeStack(top, size);
+}
+
+} // namespace kernel
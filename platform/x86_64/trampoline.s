@@ -0,0 +1,94 @@
+.intel_syntax noprefix
+
+# Application processor startup code, copied to a page below 1 MiB whose
+# number is the SIPI vector. It runs from real mode to long mode with the
+# page tables and control registers found in the parameter block, which
+# the copier fills in, then calls entry(arg) on the given stack. The page
+# must be identity mapped while it runs.
+
+.section .rodata
+.align 16
+.global kernel_x86_64_APTrampoline
+kernel_x86_64_APTrampoline:
+.code16
+        cli
+        cld
+        mov     ax, cs
+        mov     ds, ax
+        movzx   ebx, ax
+        shl     ebx, 4
+        lea     eax, [ebx + (ap_gdt - kernel_x86_64_APTrampoline)]
+        mov     [ap_gdtr_base - kernel_x86_64_APTrampoline], eax
+        lea     eax, [ebx + (ap_pm32 - kernel_x86_64_APTrampoline)]
+        mov     [ap_pm32_far - kernel_x86_64_APTrampoline], eax
+        lgdt    [ap_gdtr - kernel_x86_64_APTrampoline]
+        mov     eax, cr0
+        or      eax, 1
+        mov     cr0, eax
+        jmp     fword ptr [ap_pm32_far - kernel_x86_64_APTrampoline]
+
+.code32
+ap_pm32:
+        mov     ax, 0x10
+        mov     ds, ax
+        mov     es, ax
+        mov     ss, ax
+        mov     eax, [ebx + (ap_cr4 - kernel_x86_64_APTrampoline)]
+        mov     cr4, eax
+        mov     eax, [ebx + (ap_cr3 - kernel_x86_64_APTrampoline)]
+        mov     cr3, eax
+        mov     ecx, 0xC0000080
+        mov     eax, [ebx + (ap_efer - kernel_x86_64_APTrampoline)]
+        mov     edx, [ebx + (ap_efer - kernel_x86_64_APTrampoline) + 4]
+        wrmsr
+        mov     eax, [ebx + (ap_cr0 - kernel_x86_64_APTrampoline)]
+        mov     cr0, eax
+        lea     eax, [ebx + (ap_lm64 - kernel_x86_64_APTrampoline)]
+        mov     [ebx + (ap_lm64_far - kernel_x86_64_APTrampoline)], eax
+        jmp     fword ptr [ebx + (ap_lm64_far - kernel_x86_64_APTrampoline)]
+
+.code64
+ap_lm64:
+        mov     ebx, ebx
+        mov     rsp, [rbx + (ap_stack - kernel_x86_64_APTrampoline)]
+        mov     rdi, [rbx + (ap_arg - kernel_x86_64_APTrampoline)]
+        call    [rbx + (ap_entry - kernel_x86_64_APTrampoline)]
+        ud2
+
+.align 8
+ap_gdt:
+        .quad   0
+        .quad   0x00CF9A000000FFFF
+        .quad   0x00CF92000000FFFF
+        .quad   0x00AF9A000000FFFF
+ap_gdtr:
+        .word   4 * 8 - 1
+ap_gdtr_base:
+        .long   0
+ap_pm32_far:
+        .long   0
+        .word   0x08
+ap_lm64_far:
+        .long   0
+        .word   0x18
+
+# Layout shared with APStartParams in smp.cpp
+.align 8
+.global kernel_x86_64_APTrampolineParams
+kernel_x86_64_APTrampolineParams:
+ap_cr0:
+        .quad   0
+ap_cr3:
+        .quad   0
+ap_cr4:
+        .quad   0
+ap_efer:
+        .quad   0
+ap_stack:
+        .quad   0
+ap_entry:
+        .quad   0
+ap_arg:
+        .quad   0
+.global kernel_x86_64_APTrampolineEnd
+kernel_x86_64_APTrampolineEnd:
@@ -0,0 +1,116 @@
+#include "tsc.h"
+#include "processor.h"
+#include "kernel/log.hpp"
+#include "kernel/time.hpp"
+
+namespace kernel {
+
+auto Cycles() noexcept -> std::uint64_t
+{
+    return x86_64::ReadTSC();
+}
+
+} // namespace kernel
+
+namespace kernel::tgtspec {
+
+namespace {
+
+constexpr std::uint64_t PITFrequency = 1193182;
+constexpr std::uint64_t CalibrationMs = 10;
+constexpr int CalibrationRuns = 3;
+constexpr std::uint16_t PITLatch = PITFrequency * CalibrationMs / 1000;
+constexpr unsigned PITPollLimit = 1U << 24;
+
+enum Port {
+    Port_PITChannel2 = 0x42,
+    Port_PITCommand = 0x43,
+    Port_SystemControl = 0x61,
+};
+
+enum SystemControlFlag {
+    SystemControl_Gate2 = 1,
+    SystemControl_Speaker = 2,
+    SystemControl_Out2 = 0x20,
+};
+
+auto FrequencyFromCPUID() -> std::uint64_t
+{
+    auto maxLeaf = x86_64::CPUID(0).eax;
+    if (maxLeaf < 0x15) {
+        return 0;
+    }
+    auto tsc = x86_64::CPUID(0x15);
+    if (tsc.eax == 0 || tsc.ebx == 0) {
+        return 0;
+    }
+    if (tsc.ecx != 0) {
+        return std::uint64_t(tsc.ecx) * tsc.ebx / tsc.eax;
+    }
+    // Crystal frequency not enumerated, the base frequency equals TSC rate
+    if (maxLeaf >= 0x16) {
+        return std::uint64_t(x86_64::CPUID(0x16).eax & 0xFFFF) * 1000000;
+    }
+    return 0;
+}
+
+// Counts TSC cycles while PIT channel 2 counts down PITLatch ticks in mode 0
+auto MeasurePIT() -> std::uint64_t
+{
+    auto control = x86_64::InB(Port_SystemControl);
+    x86_64::OutB(Port_SystemControl, (control & ~SystemControl_Speaker) | SystemControl_Gate2);
+    x86_64::OutB(Port_PITCommand, 0xB0);
+    x86_64::OutB(Port_PITChannel2, PITLatch & 0xFF);
+    x86_64::OutB(Port_PITChannel2, PITLatch >> 8);
+    auto start = x86_64::ReadTSC();
+    unsigned polls = 0;
+    while (!(x86_64::InB(Port_SystemControl) & SystemControl_Out2) && ++polls != PITPollLimit) {}
+    auto end = x86_64::ReadTSC();
+    x86_64::OutB(Port_SystemControl, control);
+    return polls == PITPollLimit ? 0 : end - start;
+}
+
+// Shortest of several runs, SMIs and host preemption only make runs longer
+auto FrequencyFromPIT() -> std::uint64_t
+{
+    std::uint64_t best = ~std::uint64_t(0);
+    for (int i = 0; i < CalibrationRuns; ++i) {
+        auto cycles = MeasurePIT();
+        if (cycles != 0 && cycles < best) {
+            best = cycles;
+        }
+    }
+    if (best == ~std::uint64_t(0)) {
+        return 0;
+    }
+    return best * PITFrequency / PITLatch;
+}
+
+bool IsTSCInvariant()
+{
+    if (x86_64::CPUID(0x80000000).eax < 0x80000007) {
+        return false;
+    }
+    return x86_64::CPUID(0x80000007).edx & x86_64::CPUIDPower_EDX_InvariantTSC;
+}
+
+} // namespace
+
+void InitTSC()
+{
+    const char* source = "CPUID";
+    auto frequency = FrequencyFromCPUID();
+    if (frequency == 0) {
+        source = "PIT";
+        frequency = FrequencyFromPIT();
+    }
+    if (frequency == 0) {
+        LOG_ERROR("[TSC] calibration failed");
+        return;
+    }
+    InitClock(frequency);
+    LOG_INFO("[TSC] {} kHz from {}{}", frequency / 1000, source,
+        IsTSCInvariant() ? "" : ", not invariant");
+}
+
+} // namespace kernel::tgtspec
@@ -0,0 +1,14 @@
+#ifndef TSC_H
+#define TSC_H
+
+namespace kernel::tgtspec {
+
+/**
+ * Calibrates the TSC from CPUID leaf 15h, or against PIT channel 2 when the
+ * leaf doesn't report a frequency, and starts the kernel clock on it.
+ */
+void InitTSC();
+
+} // namespace kernel::tgtspec
+
+#endif // TSC_H
@@ -0,0 +1,267 @@
+#include "uart.h"
+#include <atomic>
+#include <cstring>
+#include "interrupts.h"
+#include "processor.h"
+#include "kernel/debug.h"
+#include "kernel/format.hpp"
+#include "kernel/log.hpp"
+#include "kernel/spinlock.hpp"
+
+namespace kernel::tgtspec {
+
+namespace {
+
+constexpr int UARTIRQ = 4;
+constexpr std::uint16_t COM1 = 0x3F8;
+constexpr std::uint16_t Divisor115200 = 1;
+// A byte takes about 90 us to loop back at 115200 baud, a port read at
+// least 1 us
+constexpr unsigned ProbeReads = 1000;
+
+enum UARTReg : std::uint16_t {
+    UARTReg_Data = 0,
+    UARTReg_IER = 1,
+    UARTReg_IIR = 2,
+    UARTReg_FCR = 2,
+    UARTReg_LCR = 3,
+    UARTReg_MCR = 4,
+    UARTReg_LSR = 5,
+    UARTReg_MSR = 6,
+    UARTReg_DivisorLow = 0,
+    UARTReg_DivisorHigh = 1,
+};
+
+enum : std::uint8_t {
+    IER_RxData = 1,
+    IER_TxEmpty = 2,
+    IER_LineStatus = 4,
+    IIR_NoInterrupt = 1,
+    IIR_IdMask = 0xE,
+    IIR_ModemStatus = 0x0,
+    IIR_TxEmpty = 0x2,
+    IIR_RxData = 0x4,
+    IIR_LineStatus = 0x6,
+    IIR_RxTimeout = 0xC,
+    IIR_FIFOEnabled = 0xC0,
+    FCR_Enable = 1,
+    FCR_ClearRx = 2,
+    FCR_ClearTx = 4,
+    FCR_RxTrigger14 = 0xC0,
+    LCR_8N1 = 3,
+    LCR_DLAB = 0x80,
+    MCR_DTR = 1,
+    MCR_RTS = 2,
+    MCR_Out2 = 8,
+    MCR_Loopback = 0x10,
+    LSR_DataReady = 1,
+};
+
+constexpr std::size_t TxRingSize = 4096;
+
+using TxRing = SPSCRing<char, TxRingSize>;
+
+// Both ends of the transmit ring are taken under txLock since writers may
+// also load the FIFO themselves when the transmitter is idle
+constinit TicketLock txLock{ "uart tx" };
+constinit TxRing txRing;
+bool txActive;
+unsigned fifoSize;
+bool present;
+
+constinit UARTInputRing rxRing;
+std::atomic<Thread*> consumer;
+std::atomic<std::uint64_t> dropped;
+std::atomic<std::uint64_t> lostOutput;
+
+auto Read(UARTReg reg) -> std::uint8_t
+{
+    return x86_64::InB(COM1 + reg);
+}
+
+void Write(UARTReg reg, std::uint8_t value)
+{
+    x86_64::OutB(COM1 + reg, value);
+}
+
+// Caller holds txLock. The FIFO is known to be empty: either a transmit
+// empty interrupt is being handled or nothing has been sent since the last
+// one found the ring empty.
+void FillTxFIFO()
+{
+    std::size_t sent = 0;
+    while (sent < fifoSize) {
+        auto span = txRing.Peek(fifoSize - sent);
+        if (span.empty()) {
+            break;
+        }
+        for (auto ch : span) {
+            Write(UARTReg_Data, std::uint8_t(ch));
+        }
+        txRing.Release(span.size());
+        sent += span.size();
+    }
+    txActive = sent != 0;
+}
+
+void ReceiveAll()
+{
+    bool received = false;
+    while (Read(UARTReg_LSR) & LSR_DataReady) {
+        auto ch = char(Read(UARTReg_Data));
+        if (!rxRing.Push(ch)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        received = true;
+    }
+    if (!received) {
+        return;
+    }
+    if (auto thread = consumer.load(std::memory_order_acquire)) {
+        thread->Wake();
+    }
+}
+
+void UARTHandler(void*, int, InterruptFrame*)
+{
+    while (true) {
+        auto iir = Read(UARTReg_IIR);
+        if (iir & IIR_NoInterrupt) {
+            return;
+        }
+        switch (iir & IIR_IdMask) {
+        case IIR_LineStatus:
+            Read(UARTReg_LSR);
+            break;
+        case IIR_RxData:
+        case IIR_RxTimeout:
+            ReceiveAll();
+            break;
+        case IIR_TxEmpty: {
+            SpinLockGuard guard(txLock);
+            FillTxFIFO();
+            break;
+        }
+        default:
+            Read(UARTReg_MSR);
+            break;
+        }
+    }
+}
+
+// A byte sent in loopback mode comes back on the receive side, which an
+// empty port can't fake. The line is set up first since the byte is only
+// received after a full frame at the programmed rate.
+bool Probe()
+{
+    Write(UARTReg_IER, 0);
+    Write(UARTReg_LCR, LCR_DLAB);
+    Write(UARTReg_DivisorLow, Divisor115200 & 0xFF);
+    Write(UARTReg_DivisorHigh, Divisor115200 >> 8);
+    Write(UARTReg_LCR, LCR_8N1);
+    Write(UARTReg_FCR, FCR_Enable | FCR_ClearRx | FCR_ClearTx | FCR_RxTrigger14);
+    Write(UARTReg_MCR, MCR_Loopback | MCR_RTS | MCR_DTR);
+    Write(UARTReg_Data, 0xAE);
+    bool ready = false;
+    for (unsigned i = 0; i < ProbeReads && !ready; ++i) {
+        ready = Read(UARTReg_LSR) & LSR_DataReady;
+    }
+    auto echoed = ready && Read(UARTReg_Data) == 0xAE;
+    Write(UARTReg_MCR, 0);
+    return echoed;
+}
+
+// Text that finds the transmit ring full is counted, and the count is
+// noted in the output once there is room again
+void LogToUART(std::string_view text)
+{
+    debug::puts(text);
+    if (auto lost = lostOutput.load(std::memory_order_relaxed); lost != 0) {
+        char note[48];
+        std::string_view line{ note, format_to(note, "[UART] {} bytes dropped\n", lost) };
+        if (UARTWrite(line) < line.size()) {
+            lostOutput.fetch_add(text.size(), std::memory_order_relaxed);
+            return;
+        }
+        lostOutput.fetch_sub(lost, std::memory_order_relaxed);
+    }
+    auto queued = UARTWrite(text);
+    if (queued < text.size()) {
+        lostOutput.fetch_add(text.size() - queued, std::memory_order_relaxed);
+    }
+}
+
+} // namespace
+
+void InitUART()
+{
+    if (!Probe()) {
+        return;
+    }
+    fifoSize = (Read(UARTReg_IIR) & IIR_FIFOEnabled) == IIR_FIFOEnabled ? 16 : 1;
+    // OUT2 gates the interrupt line on PC compatibles
+    Write(UARTReg_MCR, MCR_Out2 | MCR_RTS | MCR_DTR);
+    if (!RegisterInterruptHandler(IRQVectorBase + UARTIRQ, UARTHandler, nullptr,
+        InterruptHandlerFlag_Leaf))
+    {
+        return;
+    }
+    while (Read(UARTReg_LSR) & LSR_DataReady) {
+        Read(UARTReg_Data);
+    }
+    present = true;
+    Write(UARTReg_IER, IER_RxData | IER_TxEmpty | IER_LineStatus);
+    UnmaskIRQ(UARTIRQ);
+    SetLogSink(LogToUART);
+    LOG_INFO("[UART] COM1 16550, {}-byte FIFO", fifoSize);
+}
+
+bool UARTPresent()
+{
+    return present;
+}
+
+auto UARTWrite(std::string_view text) -> std::size_t
+{
+    if (!present) {
+        return 0;
+    }
+    SpinLockGuard guard(txLock);
+    std::size_t queued = 0;
+    while (queued < text.size()) {
+        auto span = txRing.Reserve(text.size() - queued);
+        if (span.empty()) {
+            break;
+        }
+        std::memcpy(span.data(), text.data() + queued, span.size());
+        txRing.Commit(span.size());
+        queued += span.size();
+    }
+    if (!txActive) {
+        FillTxFIFO();
+    }
+    return queued;
+}
+
+auto GetUARTInputRing() -> UARTInputRing&
+{
+    return rxRing;
+}
+
+void SetUARTConsumer(Thread* thread)
+{
+    consumer.store(thread, std::memory_order_release);
+}
+
+auto DroppedUARTInput() -> std::uint64_t
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+auto DroppedUARTOutput() -> std::uint64_t
+{
+    return lostOutput.load(std::memory_order_relaxed);
+}
+
+} // namespace kernel::tgtspec
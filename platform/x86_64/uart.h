@@ -0,0 +1,50 @@
+#ifndef UART_H
+#define UART_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "kernel/spsc_ring.hpp"
+#include "kernel/thread.hpp"
+
+namespace kernel::tgtspec {
+
+using UARTInputRing = SPSCRing<char, 256>;
+
+/**
+ * Probes COM1 and, if a 16550 is there, sets it to 115200 8N1 with the
+ * FIFOs enabled, takes over ISA IRQ 4 and adds it to the log sink. Needs
+ * EnableIRQs() first.
+ */
+void InitUART();
+
+bool UARTPresent();
+
+/**
+ * Queues text for transmission and returns how much of it fit. Never waits
+ * for the line: when the transmitter is idle the first FIFO load is written
+ * right away, the rest follows from transmit-empty interrupts.
+ */
+auto UARTWrite(std::string_view text) -> std::size_t;
+
+/**
+ * Received bytes in arrival order, read with Peek() and Release() by a
+ * single consumer.
+ */
+auto GetUARTInputRing() -> UARTInputRing&;
+
+/**
+ * Thread woken whenever bytes arrive, nullptr for none.
+ */
+void SetUARTConsumer(Thread* thread);
+
+auto DroppedUARTInput() -> std::uint64_t;
+
+/**
+ * Log bytes not yet reported as dropped because the transmit ring was full.
+ */
+auto DroppedUARTOutput() -> std::uint64_t;
+
+} // namespace kernel::tgtspec
+
+#endif // UART_H
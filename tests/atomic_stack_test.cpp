@@ -0,0 +1,154 @@
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "check.hpp"
+#include "kernel/atomic_stack.hpp"
+
+using kernel::intrusive::AtomicSListNode;
+using kernel::intrusive::AtomicStack;
+using kernel::intrusive::BaseClassCastPolicy;
+
+namespace {
+
+struct Item : AtomicSListNode<> {
+    int id;
+    // Set by whoever popped the item, so two owners at once show up
+    std::atomic<bool> owned;
+};
+
+void TestOrder()
+{
+    Item items[3] = {};
+    AtomicStack<Item> stack;
+    CHECK(stack.Empty());
+    CHECK(stack.Pop() == nullptr);
+    for (auto& item : items) {
+        stack.Push(item);
+    }
+    CHECK(!stack.Empty());
+    CHECK(stack.Pop() == &items[2]);
+    CHECK(stack.Pop() == &items[1]);
+    stack.Push(items[2]);
+    CHECK(stack.Pop() == &items[2]);
+    CHECK(stack.Pop() == &items[0]);
+    CHECK(stack.Empty());
+}
+
+void Claim(Item* item)
+{
+    if (item != nullptr) {
+        CHECK(!item->owned.exchange(true, std::memory_order_acquire));
+    }
+}
+
+void Return(AtomicStack<Item>& stack, Item* item)
+{
+    if (item != nullptr) {
+        item->owned.store(false, std::memory_order_release);
+        stack.Push(*item);
+    }
+}
+
+// Stands in for the link of a node: runs a hook once right after a load,
+// so a pop can be interrupted between reading next and its CAS
+struct HookedLink {
+    void store(AtomicSListNode<>* value, std::memory_order order) noexcept
+    {
+        link.store(value, order);
+    }
+
+    auto load(std::memory_order order) noexcept -> AtomicSListNode<>*
+    {
+        auto value = link.load(order);
+        if (auto fn = std::exchange(hook, nullptr)) {
+            fn();
+        }
+        return value;
+    }
+
+    std::atomic<AtomicSListNode<>*> link;
+    static inline void (*hook)();
+};
+
+// Shadows the link of AtomicSListNode, which the stack reaches through
+// its node type only
+struct HookedNode : AtomicSListNode<> {
+    HookedLink next;
+};
+
+struct HookedItem : HookedNode {};
+
+using HookedStack = AtomicStack<HookedItem, BaseClassCastPolicy<HookedNode, HookedItem>>;
+
+HookedItem a, b, c;
+HookedStack hooked;
+
+// The pop reads top a and its next b, then a, b are popped and a pushed
+// back on top of c. Top is a again, only the tag tells the pop that b
+// is stale.
+void TestABAInterleaved()
+{
+    hooked.Push(c);
+    hooked.Push(b);
+    hooked.Push(a);
+    HookedLink::hook = [] {
+        CHECK(hooked.Pop() == &a);
+        CHECK(hooked.Pop() == &b);
+        hooked.Push(a);
+    };
+    CHECK(hooked.Pop() == &a);
+    CHECK(HookedLink::hook == nullptr);
+    CHECK(hooked.Pop() == &c);
+    CHECK(hooked.Pop() == nullptr);
+}
+
+// Few items and many threads popping two and pushing the first back alone:
+// a pop that read top A with next B and stalls sees A on top again, now
+// with another next. Only the tag makes its CAS fail instead of installing
+// B, which another thread still owns.
+void TestABA()
+{
+    constexpr int ItemCount = 4;
+    constexpr int Iterations = 200000;
+    Item items[ItemCount] = {};
+    AtomicStack<Item> stack;
+    for (int i = 0; i < ItemCount; ++i) {
+        items[i].id = i;
+        stack.Push(items[i]);
+    }
+    auto threads = std::max(4u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&stack] {
+            for (int i = 0; i < Iterations; ++i) {
+                auto a = stack.Pop();
+                Claim(a);
+                auto b = stack.Pop();
+                Claim(b);
+                Return(stack, a);
+                Return(stack, b);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    bool seen[ItemCount] = {};
+    int count = 0;
+    while (auto item = stack.Pop()) {
+        CHECK(!seen[item->id]);
+        seen[item->id] = true;
+        ++count;
+    }
+    CHECK(count == ItemCount);
+}
+
+} // namespace
+
+int main()
+{
+    TestOrder();
+    TestABAInterleaved();
+    TestABA();
+}
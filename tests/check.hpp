@@ -0,0 +1,20 @@
+#ifndef TESTS_CHECK_HPP
+#define TESTS_CHECK_HPP
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace test {
+
+[[noreturn]] inline void Fail(const char* expr, const char* file, int line)
+{
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    std::exit(1);
+}
+
+} // namespace test
+
+// Unlike assert(), stays active in release builds
+#define CHECK(cond) ((cond) ? void(0) : ::test::Fail(#cond, __FILE__, __LINE__))
+
+#endif // TESTS_CHECK_HPP
@@ -0,0 +1,177 @@
+// Throughput of the lock-free containers against a List under a TicketLock,
+// the way the kernel would share one otherwise
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "kernel/atomic_stack.hpp"
+#include "kernel/list.hpp"
+#include "kernel/mpsc_queue.hpp"
+#include "kernel/spinlock.hpp"
+
+using kernel::TicketLock;
+using kernel::intrusive::AtomicSListNode;
+using kernel::intrusive::AtomicStack;
+using kernel::intrusive::List;
+using kernel::intrusive::ListNode;
+using kernel::intrusive::MPSCQueue;
+
+namespace {
+
+constexpr std::size_t Operations = 2000000;
+
+struct Item : AtomicSListNode<>, ListNode<> {};
+
+class LockedStack {
+public:
+    void Push(Item& item)
+    {
+        lock.Lock();
+        list.PushBack(item);
+        lock.Unlock();
+    }
+
+    auto Pop() -> Item*
+    {
+        Item* item = nullptr;
+        lock.Lock();
+        if (!list.Empty()) {
+            item = &*--list.End();
+            list.PopBack();
+        }
+        lock.Unlock();
+        return item;
+    }
+private:
+    TicketLock lock;
+    List<Item> list;
+};
+
+class LockedQueue {
+public:
+    void Push(Item& item)
+    {
+        lock.Lock();
+        list.PushBack(item);
+        lock.Unlock();
+    }
+
+    auto Pop() -> Item*
+    {
+        Item* item = nullptr;
+        lock.Lock();
+        if (!list.Empty()) {
+            item = &*list.Begin();
+            list.Erase(list.Begin());
+        }
+        lock.Unlock();
+        return item;
+    }
+private:
+    TicketLock lock;
+    List<Item> list;
+};
+
+template <typename Fn>
+auto Measure(Fn&& fn) -> double
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void Report(const char* name, unsigned threads, std::size_t operations, double seconds)
+{
+    std::printf("%-14s %3u thread(s) %8.2f Mop/s\n", name, threads, operations / seconds / 1e6);
+}
+
+// Every thread pops an item and pushes it back, a shared free list
+template <typename Stack>
+void StackBench(const char* name, unsigned threads)
+{
+    Stack stack;
+    std::vector<Item> items(threads * 2);
+    for (auto& item : items) {
+        stack.Push(item);
+    }
+    auto perThread = Operations / threads;
+    auto seconds = Measure([&] {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&stack, perThread] {
+                for (std::size_t i = 0; i < perThread; ++i) {
+                    if (auto item = stack.Pop()) {
+                        stack.Push(*item);
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    });
+    Report(name, threads, perThread * threads * 2, seconds);
+}
+
+// producers push their own items, one consumer takes them all
+template <typename Queue>
+void QueueBench(const char* name, unsigned producers)
+{
+    Queue queue;
+    auto perProducer = Operations / producers;
+    auto items = std::make_unique<Item[]>(perProducer * producers);
+    auto seconds = Measure([&] {
+        std::vector<std::thread> workers;
+        for (unsigned p = 0; p < producers; ++p) {
+            workers.emplace_back([&queue, &items, perProducer, p] {
+                for (std::size_t i = 0; i < perProducer; ++i) {
+                    queue.Push(items[p * perProducer + i]);
+                }
+            });
+        }
+        for (std::size_t received = 0; received < perProducer * producers;) {
+            if (queue.Pop() != nullptr) {
+                ++received;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    });
+    Report(name, producers, perProducer * producers * 2, seconds);
+}
+
+} // namespace
+
+int main()
+{
+    std::setvbuf(stdout, nullptr, _IOLBF, 0);
+    // More spinning threads than CPUs measures the scheduler, not the lock
+    auto cpus = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < cpus; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(cpus);
+    for (auto threads : counts) {
+        StackBench<AtomicStack<Item>>("AtomicStack", threads);
+        StackBench<LockedStack>("locked List", threads);
+    }
+    // The consumer takes a CPU of its own
+    if (cpus == 1) {
+        std::printf("queues need 2 CPUs\n");
+    }
+    for (auto producers : counts) {
+        if (producers < cpus) {
+            QueueBench<MPSCQueue<Item>>("MPSCQueue", producers);
+            QueueBench<LockedQueue>("locked List", producers);
+        }
+    }
+}
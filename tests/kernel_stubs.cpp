@@ -0,0 +1,199 @@
+// Host versions of the platform hooks the generic code calls. Interrupts
+// don't exist, so disabling them only has to keep the calling thread on
+// its CPU, which a thread bound by BindCPU() never leaves.
+#include "kernel_stubs.hpp"
+#include <asm/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "kernel/cpu.hpp"
+#include "kernel/deferred_work.hpp"
+#include "kernel/executor.hpp"
+#include "kernel/interrupts.hpp"
+#include "kernel/thread.hpp"
+#include "kernel/time.hpp"
+#include "kernel/timer.hpp"
+
+namespace kernel {
+
+namespace timer_detail {
+
+// Armed timers in a plain list, fired by test::RunTimers()
+struct Wheel {
+    std::mutex lock;
+    std::vector<Timer*> armed;
+
+    void Arm(Timer& timer, std::uint64_t deadline)
+    {
+        std::lock_guard guard(lock);
+        if (!timer.Pending()) {
+            armed.push_back(&timer);
+        }
+        timer.expires = deadline;
+        timer.level = 0;
+    }
+
+    bool Cancel(Timer& timer)
+    {
+        std::lock_guard guard(lock);
+        if (!timer.Pending()) {
+            return false;
+        }
+        std::erase(armed, &timer);
+        timer.level = Timer::Idle;
+        return true;
+    }
+
+    void Run()
+    {
+        std::vector<Timer*> due;
+        {
+            std::lock_guard guard(lock);
+            auto now = Now();
+            std::erase_if(armed, [&](Timer* timer) {
+                if (timer->expires > now) {
+                    return false;
+                }
+                timer->level = Timer::Idle;
+                due.push_back(timer);
+                return true;
+            });
+        }
+        for (auto timer : due) {
+            timer->fn(timer->ctx);
+        }
+    }
+};
+
+} // namespace timer_detail
+
+namespace {
+
+std::atomic<unsigned> cpuCount{ 1 };
+timer_detail::Wheel wheel;
+std::mutex workLock;
+std::vector<DeferredWork*> scheduled;
+
+} // namespace
+
+auto SaveAndDisableInterrupts() noexcept -> InterruptState
+{
+    return 0;
+}
+
+void RestoreInterrupts(InterruptState) noexcept {}
+
+void EnableInterrupts() noexcept {}
+
+void WaitForInterrupt() noexcept
+{
+    std::this_thread::yield();
+}
+
+auto Cycles() noexcept -> std::uint64_t
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+auto CPUCount() noexcept -> unsigned
+{
+    return cpuCount.load(std::memory_order_acquire);
+}
+
+void WakeIdleCPUs() noexcept {}
+
+void Timer::Arm(std::uint64_t deadline) noexcept
+{
+    wheel.Arm(*this, deadline);
+}
+
+bool Timer::Cancel() noexcept
+{
+    return wheel.Cancel(*this);
+}
+
+bool DeferredWork::Schedule() noexcept
+{
+    if (requests.fetch_add(1, std::memory_order_acq_rel) != 0) {
+        return false;
+    }
+    std::lock_guard guard(workLock);
+    scheduled.push_back(this);
+    return true;
+}
+
+auto RunDeferredWork(unsigned budget) noexcept -> bool
+{
+    std::vector<DeferredWork*> batch;
+    {
+        std::lock_guard guard(workLock);
+        auto count = std::min<std::size_t>(budget, scheduled.size());
+        batch.assign(scheduled.begin(), scheduled.begin() + count);
+        scheduled.erase(scheduled.begin(), scheduled.begin() + count);
+    }
+    for (auto work : batch) {
+        work->fn(work->ctx, work->requests.exchange(0, std::memory_order_acq_rel));
+    }
+    return DeferredWorkPending();
+}
+
+bool DeferredWorkPending() noexcept
+{
+    std::lock_guard guard(workLock);
+    return !scheduled.empty();
+}
+
+// There is no scheduler: code that blocks a kernel thread can't be tested
+auto Thread::Current() noexcept -> Thread&
+{
+    std::fprintf(stderr, "Thread::Current() has no host version\n");
+    std::abort();
+}
+
+void Thread::Wake() noexcept
+{
+    std::abort();
+}
+
+void Block() noexcept
+{
+    std::abort();
+}
+
+} // namespace kernel
+
+namespace test {
+
+void BindCPU(unsigned index)
+{
+    static std::once_flag clockStarted;
+    std::call_once(clockStarted, [] { kernel::InitClock(kernel::NsPerSecond); });
+    thread_local kernel::CPU cpu;
+    cpu.self = &cpu;
+    cpu.index = index;
+    if (syscall(SYS_arch_prctl, ARCH_SET_GS, &cpu) != 0) {
+        std::perror("arch_prctl(ARCH_SET_GS)");
+        std::exit(1);
+    }
+}
+
+void SetCPUCount(unsigned count)
+{
+    kernel::cpuCount.store(count, std::memory_order_release);
+}
+
+void RunTimers()
+{
+    kernel::wheel.Run();
+    while (kernel::RunDeferredWork(16)) {}
+}
+
+} // namespace test
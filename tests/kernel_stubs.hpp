@@ -0,0 +1,23 @@
+#ifndef TESTS_KERNEL_STUBS_HPP
+#define TESTS_KERNEL_STUBS_HPP
+
+namespace test {
+
+/**
+ * Makes the calling thread CPU index for this_cpu(), which reads its data
+ * block through GS as in the kernel, and starts the clock on first use.
+ * CPUCount() is what SetCPUCount() last set.
+ */
+void BindCPU(unsigned index);
+void SetCPUCount(unsigned count);
+
+/**
+ * Runs the timers that are due and then the scheduled deferred work, what
+ * the timer interrupt does in the kernel. Call from the thread bound to
+ * CPU 0, where timers live.
+ */
+void RunTimers();
+
+} // namespace test
+
+#endif // TESTS_KERNEL_STUBS_HPP
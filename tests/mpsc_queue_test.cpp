@@ -0,0 +1,83 @@
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "kernel/mpsc_queue.hpp"
+
+using kernel::intrusive::AtomicSListNode;
+using kernel::intrusive::MPSCQueue;
+
+namespace {
+
+struct Item : AtomicSListNode<> {
+    unsigned producer;
+    std::size_t seq;
+};
+
+void TestOrder()
+{
+    Item items[3] = {};
+    MPSCQueue<Item> queue;
+    CHECK(queue.Empty());
+    CHECK(queue.Pop() == nullptr);
+    queue.Push(items[0]);
+    CHECK(!queue.Empty());
+    // The last item is detached by pushing the stub behind it
+    CHECK(queue.Pop() == &items[0]);
+    CHECK(queue.Empty());
+    queue.Push(items[1]);
+    queue.Push(items[2]);
+    queue.Push(items[0]);
+    CHECK(queue.Pop() == &items[1]);
+    CHECK(queue.Pop() == &items[2]);
+    CHECK(queue.Pop() == &items[0]);
+    CHECK(queue.Pop() == nullptr);
+    CHECK(queue.Empty());
+}
+
+// Items of one producer must come out in the order it pushed them, however
+// they interleave with the others
+void TestProducerFIFO()
+{
+    constexpr std::size_t PerProducer = 200000;
+    auto producers = std::max(3u, std::thread::hardware_concurrency() - 1);
+    auto items = std::make_unique<Item[]>(producers * PerProducer);
+    MPSCQueue<Item> queue;
+    std::vector<std::thread> workers;
+    for (unsigned p = 0; p < producers; ++p) {
+        workers.emplace_back([&queue, &items, p] {
+            for (std::size_t i = 0; i < PerProducer; ++i) {
+                auto& item = items[p * PerProducer + i];
+                item.producer = p;
+                item.seq = i;
+                queue.Push(item);
+            }
+        });
+    }
+    std::vector<std::size_t> expected(producers);
+    for (std::size_t received = 0; received < producers * PerProducer;) {
+        // nullptr also while a producer is between exchange and link
+        auto item = queue.Pop();
+        if (item == nullptr) {
+            continue;
+        }
+        CHECK(item->producer < producers);
+        CHECK(item->seq == expected[item->producer]);
+        ++expected[item->producer];
+        ++received;
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    CHECK(queue.Pop() == nullptr);
+    CHECK(queue.Empty());
+}
+
+} // namespace
+
+int main()
+{
+    TestOrder();
+    TestProducerFIFO();
+}
@@ -0,0 +1,116 @@
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "check.hpp"
+#include "kernel/page_magazine.hpp"
+
+namespace {
+
+constexpr std::uint64_t PageSize = 0x1000;
+
+using Magazine = kernel::PageMagazine<2, PageSize>;
+
+constexpr auto Invalid = Magazine::Invalid;
+
+// Hands out one block and a number of single pages, records frees
+struct FakeBuddy {
+    std::uint64_t block = Invalid;
+    std::vector<std::uint64_t> singles;
+    std::vector<std::uint64_t> freed;
+    int blockLevel = -1;
+
+    auto AllocPages(int level) -> std::uint64_t
+    {
+        blockLevel = level;
+        return std::exchange(block, Invalid);
+    }
+
+    auto alloc() -> std::uint64_t
+    {
+        if (singles.empty()) {
+            return Invalid;
+        }
+        auto page = singles.back();
+        singles.pop_back();
+        return page;
+    }
+
+    void free(std::uint64_t page)
+    {
+        freed.push_back(page);
+    }
+};
+
+void TestRefillFromBlock()
+{
+    Magazine mag{};
+    FakeBuddy buddy;
+    buddy.block = 0x100000;
+    buddy.singles = { 0x5000 };
+    CHECK(mag.Refill(buddy));
+    CHECK(buddy.blockLevel == 2);
+    CHECK(mag.count == Magazine::Batch);
+    // The block is used whole and handed out from its lowest address
+    CHECK(buddy.singles.size() == 1);
+    for (std::ptrdiff_t i = 0; i != Magazine::Batch; ++i) {
+        CHECK(mag.Pop() == 0x100000 + std::uint64_t(i) * PageSize);
+    }
+    CHECK(mag.Empty());
+}
+
+void TestRefillSinglePages()
+{
+    Magazine mag{};
+    FakeBuddy buddy;
+    buddy.singles = { 0x7000, 0x3000, 0x9000 };
+    CHECK(mag.Refill(buddy));
+    CHECK(mag.count == 3);
+    CHECK(buddy.singles.empty());
+    CHECK(mag.Pop() == 0x7000);
+
+    // Stops at Batch even when more pages are left
+    Magazine full{};
+    buddy.singles = { 1, 2, 3, 4, 5, 6 };
+    CHECK(full.Refill(buddy));
+    CHECK(full.count == Magazine::Batch);
+    CHECK(buddy.singles.size() == 2);
+
+    // A partial refill still succeeds, only no page at all fails
+    Magazine partial{};
+    CHECK(partial.Refill(buddy));
+    CHECK(partial.count == 2);
+    Magazine none{};
+    CHECK(!none.Refill(buddy));
+    CHECK(none.Empty());
+}
+
+void TestDrainOldest()
+{
+    Magazine mag{};
+    FakeBuddy buddy;
+    for (std::uint64_t page = 0; !mag.Full(); ++page) {
+        mag.Push(page * PageSize);
+    }
+    CHECK(mag.count == Magazine::Capacity);
+    mag.Drain(buddy);
+    // The pages pushed first go back, the recent ones stay on top
+    CHECK(std::ptrdiff_t(buddy.freed.size()) == Magazine::Batch);
+    for (std::ptrdiff_t i = 0; i != Magazine::Batch; ++i) {
+        CHECK(buddy.freed[i] == std::uint64_t(i) * PageSize);
+    }
+    CHECK(mag.count == Magazine::Capacity - Magazine::Batch);
+    for (auto i = Magazine::Capacity; i != Magazine::Batch;) {
+        --i;
+        CHECK(mag.Pop() == std::uint64_t(i) * PageSize);
+    }
+    CHECK(mag.Empty());
+}
+
+} // namespace
+
+int main()
+{
+    TestRefillFromBlock();
+    TestRefillSinglePages();
+    TestDrainOldest();
+}
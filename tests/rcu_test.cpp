@@ -0,0 +1,109 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "kernel_stubs.hpp"
+#include "kernel/rcu.hpp"
+
+using kernel::RCUHead;
+
+namespace {
+
+constexpr unsigned Readers = 3;
+constexpr unsigned Retirements = 3000;
+// Retired objects the writer lets wait at once, so that they are spread
+// over many grace periods instead of filling a few batches
+constexpr unsigned MaxInFlight = 8;
+// Read-side sections a reader runs between two quiescent states
+constexpr unsigned SectionsPerQuiescentState = 16;
+// The first of them outlasts the RCU poll period, so a grace period that
+// ends too early frees the object under it
+constexpr auto SlowSection = std::chrono::milliseconds(2);
+
+struct Object : RCUHead {
+    // Readers inside a section that found this object
+    std::atomic<unsigned> readers{ 0 };
+    // Set by the retire callback instead of freeing, so a reader that still
+    // holds the object is caught rather than touching freed memory
+    std::atomic<bool> freed{ false };
+};
+
+std::atomic<Object*> current;
+std::atomic<unsigned> reclaimed;
+
+void Reclaim(RCUHead* head)
+{
+    auto& object = static_cast<Object&>(*head);
+    CHECK(object.readers.load(std::memory_order_acquire) == 0);
+    object.freed.store(true, std::memory_order_release);
+    reclaimed.fetch_add(1, std::memory_order_relaxed);
+}
+
+// CPU index + 1. Every section checks that the object it found stays alive
+// to its end; quiescent states come only between sections, as in the kernel.
+void Reader(unsigned cpu, std::atomic<bool>& stop)
+{
+    test::BindCPU(cpu);
+    while (!stop.load(std::memory_order_acquire)) {
+        for (unsigned i = 0; i < SectionsPerQuiescentState; ++i) {
+            kernel::RCUReadGuard guard;
+            auto object = kernel::RCUDereference(current);
+            object->readers.fetch_add(1, std::memory_order_acq_rel);
+            CHECK(!object->freed.load(std::memory_order_acquire));
+            if (i == 0) {
+                std::this_thread::sleep_for(SlowSection);
+            } else {
+                std::this_thread::yield();
+            }
+            CHECK(!object->freed.load(std::memory_order_acquire));
+            object->readers.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        kernel::RCUQuiescentState();
+    }
+}
+
+// CPU 0 replaces the object, retires the old one and runs the timers that
+// poll for the end of grace periods
+void TestGracePeriods()
+{
+    test::SetCPUCount(Readers + 1);
+    test::BindCPU(0);
+    auto objects = std::make_unique<Object[]>(Retirements + 1);
+    kernel::RCUAssign(current, &objects[0]);
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> readers;
+    for (unsigned cpu = 1; cpu <= Readers; ++cpu) {
+        readers.emplace_back(Reader, cpu, std::ref(stop));
+    }
+    for (unsigned i = 1; i <= Retirements; ++i) {
+        auto old = current.load(std::memory_order_relaxed);
+        kernel::RCUAssign(current, &objects[i]);
+        kernel::RCURetire(*old, Reclaim);
+        while (i - reclaimed.load(std::memory_order_relaxed) > MaxInFlight) {
+            test::RunTimers();
+            std::this_thread::yield();
+        }
+    }
+    while (reclaimed.load(std::memory_order_relaxed) != Retirements) {
+        test::RunTimers();
+        std::this_thread::yield();
+    }
+    stop.store(true, std::memory_order_release);
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    for (unsigned i = 0; i < Retirements; ++i) {
+        CHECK(objects[i].freed.load());
+    }
+    CHECK(!objects[Retirements].freed.load());
+}
+
+} // namespace
+
+int main()
+{
+    TestGracePeriods();
+}
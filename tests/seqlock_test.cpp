@@ -0,0 +1,95 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "kernel_stubs.hpp"
+#include "kernel/seqlock.hpp"
+
+using kernel::SeqLock;
+
+namespace {
+
+// Larger than a word, so a read racing a write could mix two values
+struct Snapshot {
+    std::uint64_t a;
+    std::uint64_t b;
+    std::uint32_t c;
+    std::uint64_t d;
+};
+
+constexpr std::uint64_t UpdatesPerWriter = 200000;
+
+// Writers increment every field at once, so a snapshot whose fields differ
+// is torn. Values never go back, so a reader never sees them drop.
+void TestTornReads()
+{
+    // A ticket lock holder that gets preempted stalls every waiter behind
+    // it, so writers don't outnumber CPUs; there is always a reader
+    auto cpus = std::max(1u, std::thread::hardware_concurrency());
+    auto writers = std::min(2u, cpus);
+    auto readers = std::max(1u, cpus - writers);
+    SeqLock<Snapshot> lock(Snapshot{ 0, 0, 0, 0 });
+    std::atomic<bool> done{ false };
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < writers; ++w) {
+        threads.emplace_back([&lock] {
+            for (std::uint64_t i = 0; i < UpdatesPerWriter; ++i) {
+                lock.Update([](Snapshot& value) {
+                    ++value.a;
+                    ++value.b;
+                    ++value.c;
+                    ++value.d;
+                });
+            }
+        });
+    }
+    std::atomic<std::uint64_t> reads{ 0 };
+    for (unsigned r = 0; r < readers; ++r) {
+        threads.emplace_back([&, writers] {
+            std::uint64_t last = 0;
+            std::uint64_t count = 0;
+            // At least one read after the writers are done
+            bool final;
+            do {
+                final = done.load(std::memory_order_acquire);
+                auto value = lock.Read();
+                CHECK(value.a == value.b);
+                CHECK(value.a == value.d);
+                CHECK(std::uint32_t(value.a) == value.c);
+                CHECK(value.a >= last);
+                last = value.a;
+                ++count;
+            } while (!final);
+            CHECK(last == writers * UpdatesPerWriter);
+            reads.fetch_add(count, std::memory_order_relaxed);
+        });
+    }
+    for (unsigned w = 0; w < writers; ++w) {
+        threads[w].join();
+    }
+    done.store(true, std::memory_order_release);
+    for (auto w = writers; w < threads.size(); ++w) {
+        threads[w].join();
+    }
+    CHECK(reads.load() >= readers);
+}
+
+void TestWrite()
+{
+    SeqLock<Snapshot> lock;
+    auto value = lock.Read();
+    CHECK(value.a == 0 && value.d == 0);
+    lock.Write(Snapshot{ 1, 2, 3, 4 });
+    value = lock.Read();
+    CHECK(value.a == 1 && value.b == 2 && value.c == 3 && value.d == 4);
+}
+
+} // namespace
+
+int main()
+{
+    test::BindCPU(0);
+    TestWrite();
+    TestTornReads();
+}
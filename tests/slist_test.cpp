@@ -0,0 +1,85 @@
+#include <utility>
+#include "check.hpp"
+#include "kernel/slist.hpp"
+
+using kernel::intrusive::BaseClassCastPolicy;
+using kernel::intrusive::SList;
+using kernel::intrusive::SListNode;
+
+namespace {
+
+struct FreeTag;
+struct ReadyTag;
+
+// On two lists at once through tagged nodes
+struct Item : SListNode<FreeTag>, SListNode<ReadyTag> {
+    int id;
+};
+
+using FreeList = SList<Item, BaseClassCastPolicy<SListNode<FreeTag>, Item>>;
+using ReadyList = SList<Item, BaseClassCastPolicy<SListNode<ReadyTag>, Item>>;
+
+void TestLIFO()
+{
+    Item items[3] = { {{}, {}, 0}, {{}, {}, 1}, {{}, {}, 2} };
+    FreeList list;
+    CHECK(list.Empty());
+    CHECK(list.PopFront() == nullptr);
+    for (auto& item : items) {
+        list.PushFront(item);
+    }
+    CHECK(!list.Empty());
+    CHECK(&list.Front() == &items[2]);
+    int expected = 2;
+    for (auto& item : list) {
+        CHECK(item.id == expected--);
+    }
+    CHECK(expected == -1);
+    CHECK(list.PopFront() == &items[2]);
+    CHECK(list.PopFront() == &items[1]);
+    CHECK(list.PopFront() == &items[0]);
+    CHECK(list.PopFront() == nullptr);
+    CHECK(list.Empty());
+}
+
+void TestTags()
+{
+    Item items[2] = { {{}, {}, 0}, {{}, {}, 1} };
+    FreeList free;
+    ReadyList ready;
+    free.PushFront(items[0]);
+    free.PushFront(items[1]);
+    ready.PushFront(items[0]);
+    ready.PushFront(items[1]);
+    CHECK(free.PopFront() == &items[1]);
+    // Unlinking from one list leaves the other link alone
+    CHECK(ready.PopFront() == &items[1]);
+    CHECK(ready.PopFront() == &items[0]);
+    CHECK(free.PopFront() == &items[0]);
+}
+
+void TestMove()
+{
+    Item items[2] = {};
+    FreeList list;
+    list.PushFront(items[0]);
+    list.PushFront(items[1]);
+    FreeList moved(std::move(list));
+    CHECK(list.Empty());
+    CHECK(moved.PopFront() == &items[1]);
+    list = std::move(moved);
+    CHECK(moved.Empty());
+    CHECK(list.PopFront() == &items[0]);
+    list.PushFront(items[0]);
+    list.Clear();
+    CHECK(list.Empty());
+}
+
+} // namespace
+
+int main()
+{
+    TestLIFO();
+    TestTags();
+    TestMove();
+}